@@ -0,0 +1,99 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "include/minimodbus.h"
+
+#define BULK_SIZE (1024 * 1024)
+#define MIN_BENCHMARK_TIME 0.2
+
+static const char *implementation_names[] = {"table", "slicing-by-8", "clmul"};
+static const size_t sizes[] = {8, 64, 256, 4096, BULK_SIZE};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main()
+{
+    uint8_t *data = malloc(BULK_SIZE);
+    if (data == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    srand(42);
+    for (size_t i = 0; i < BULK_SIZE; i++) {
+        data[i] = rand() & 0xFF;
+    }
+
+    printf("%-14s", "bytes");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        printf("%12zu", sizes[s]);
+    }
+    printf("  (MB/s)\n");
+
+    for (int implementation = MiniModbusCrc_Table; implementation <= MiniModbusCrc_Clmul; implementation++) {
+        uint16_t crc;
+        printf("%-14s", implementation_names[implementation]);
+
+        if (MiniModbus_Crc16Implementation(implementation, data, 1, &crc) != MiniModbusError_Success) {
+            printf("  not available\n");
+            continue;
+        }
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            volatile uint16_t sink = 0;
+            size_t iterations = 0;
+            double start = now();
+            double elapsed;
+
+            do {
+                for (int i = 0; i < 64; i++) {
+                    MiniModbus_Crc16Implementation(implementation, data, sizes[s], &crc);
+                    sink ^= crc;
+                }
+                iterations += 64;
+                elapsed = now() - start;
+            } while (elapsed < MIN_BENCHMARK_TIME);
+
+            printf("%12.1f", (double)iterations * sizes[s] / elapsed / 1e6);
+        }
+        printf("\n");
+    }
+
+    free(data);
+
+    return 0;
+}
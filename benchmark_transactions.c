@@ -0,0 +1,171 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "include/minimodbus.h"
+#include "include/minimodbus_sim.h"
+
+#define REGISTER_COUNT 1024
+
+typedef enum Operation {
+    Operation_ReadOne,
+    Operation_ReadBlock,
+    Operation_ReadBlockFrame,
+    Operation_WriteOne,
+} Operation_t;
+
+static const char *operation_names[] = {"read 1 register", "read block", "read block frame",
+                                          "write 1 register"};
+
+static uint16_t registers[REGISTER_COUNT];
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void run(MiniModbusMode_t mode, int buffered, Operation_t operation, size_t transactions, uint32_t latency_us,
+                uint32_t error_rate_ppm, uint64_t *latencies)
+{
+    MiniModbusSim_t sim;
+    MiniModbusSim_Init(&sim, mode, 1, registers, REGISTER_COUNT);
+    sim.latency_us = latency_us;
+    sim.drop_rate_ppm = error_rate_ppm / 3;
+    sim.corrupt_rate_ppm = error_rate_ppm / 3;
+    sim.exception_rate_ppm = error_rate_ppm / 3;
+
+    MiniModbusConfig_t config;
+    MiniModbusSim_Config(&sim, &config);
+
+    // the buffered transport reads each response with a single call, when it's all available
+    MiniModbusBufferedTransport_t transport;
+    if (buffered) {
+        config.receive = MiniModbusSim_Read;
+        MiniModbus_BufferedTransportInit(&transport, &config);
+    }
+
+    MiniModbusContext_t ctx;
+    MiniModbus_Init(&ctx, &config);
+
+    // the largest block that fits the context buffer in this mode
+    uint16_t block = mode == MiniModbusMode_TCP ? 123 : MINI_MODBUS_MAX_READ_REGISTERS;
+    uint16_t values[MINI_MODBUS_MAX_READ_REGISTERS];
+    size_t errors = 0;
+
+    // a polling loop repeats the same request: encode it once
+    MiniModbusFrame_t frame;
+    MiniModbus_FrameReadHoldingRegisters(&ctx, &frame, 0, block);
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < transactions; i++) {
+        uint16_t reg = (i * 7) % (REGISTER_COUNT - block);
+        MiniModbusError_t error = MiniModbusError_Success;
+
+        uint64_t transaction_start = now_ns();
+        switch (operation) {
+        case Operation_ReadOne:
+            error = MiniModbus_ReadHoldingRegister(&ctx, reg, values);
+            break;
+        case Operation_ReadBlock:
+            error = MiniModbus_ReadHoldingRegisters(&ctx, reg, block, values);
+            break;
+        case Operation_ReadBlockFrame:
+            error = MiniModbus_FrameExecute(&ctx, &frame, values);
+            break;
+        case Operation_WriteOne:
+            error = MiniModbus_WriteSingleRegister(&ctx, reg, i & 0xFFFF);
+            break;
+        }
+        latencies[i] = now_ns() - transaction_start;
+
+        if (error != MiniModbusError_Success) {
+            errors++;
+            if (buffered) {
+                MiniModbus_BufferedTransportFlush(&transport);
+            }
+        }
+    }
+    double elapsed = (now_ns() - start) / 1e9;
+
+    // on a real transport each send/receive call is (at least) a system call
+    double calls = (double)(sim.send_calls + sim.receive_calls) / transactions;
+
+    qsort(latencies, transactions, sizeof(uint64_t), compare_uint64);
+
+    printf("%-3s %-4s %-17s %12.0f %10.2f %10.2f %12.2f %8zu\n", mode == MiniModbusMode_TCP ? "TCP" : "RTU",
+           buffered ? "buf" : "", operation_names[operation], transactions / elapsed, latencies[transactions / 2] / 1e3,
+           latencies[transactions * 99 / 100] / 1e3, calls, errors);
+}
+
+int main(int argc, char **argv)
+{
+    size_t transactions = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    uint32_t latency_us = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    uint32_t error_rate_ppm = argc > 3 ? strtoul(argv[3], NULL, 10) : 0;
+
+    if (transactions == 0) {
+        fprintf(stderr, "usage: %s [transactions] [latency_us] [error_rate_ppm]\n", argv[0]);
+        exit(1);
+    }
+
+    uint64_t *latencies = malloc(transactions * sizeof(uint64_t));
+    if (latencies == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    printf("%zu transactions per run, slave latency %u us, injected error rate %u ppm\n\n", transactions, latency_us,
+           error_rate_ppm);
+    printf("%-8s %-17s %12s %10s %10s %12s %8s\n", "mode", "operation", "trans/s", "p50 (us)", "p99 (us)",
+           "calls/trans", "errors");
+
+    for (int mode = MiniModbusMode_RTU; mode <= MiniModbusMode_TCP; mode++) {
+        for (int buffered = 0; buffered <= 1; buffered++) {
+            for (int operation = Operation_ReadOne; operation <= Operation_WriteOne; operation++) {
+                run(mode, buffered, operation, transactions, latency_us, error_rate_ppm, latencies);
+            }
+        }
+    }
+
+    free(latencies);
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "include/minimodbus_capture.h"
+#include "include/minimodbus_sim.h"
+
+#define REGISTER_COUNT 65536
+#define BLOCK_SIZE 64
+
+static uint16_t registers[REGISTER_COUNT];
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: capture_tool record FILE [CYCLES] [DEVICES]\n"
+                    "       capture_tool dump FILE\n"
+                    "       capture_tool follow FILE\n"
+                    "       capture_tool replay FILE [DEVICE]\n");
+    exit(2);
+}
+
+static void print_record(uint64_t sequence, const MiniModbusCaptureRecord_t *record)
+{
+    printf("%" PRIu64 " %" PRIu64 ".%06" PRIu64 " device %u fc 0x%02x address %u count %u", sequence,
+           record->timestamp_us / 1000000, record->timestamp_us % 1000000, record->device, record->function_code,
+           record->address, record->count);
+    if (record->error != MiniModbusError_Success) {
+        printf(" error %d\n", record->error);
+        return;
+    }
+    for (uint16_t i = 0; i < record->count; i++) {
+        printf(" %u", record->values[i]);
+    }
+    printf("\n");
+}
+
+/*
+ * Print the records from sequence to head, skipping the ones overwritten meanwhile.
+ * The line is built from the record in place: it's printed only if the record was still valid after.
+ */
+static uint64_t print_records(MiniModbusCapture_t *capture, uint64_t sequence, uint64_t head)
+{
+    if (sequence < MiniModbus_CaptureOldest(capture, head)) {
+        fprintf(stderr, "lost %" PRIu64 " records\n", MiniModbus_CaptureOldest(capture, head) - sequence);
+        sequence = MiniModbus_CaptureOldest(capture, head);
+    }
+
+    for (; sequence < head; sequence++) {
+        const MiniModbusCaptureRecord_t *record = MiniModbus_CaptureRecord(capture, sequence);
+        if (record == NULL) {
+            continue;
+        }
+
+        MiniModbusCaptureRecord_t copy = *record;
+        if (MiniModbus_CaptureValid(record, sequence)) {
+            print_record(sequence, &copy);
+        }
+    }
+
+    return sequence;
+}
+
+/*
+ * Poll a simulated slave as if it was a set of devices, each with a block of registers, and capture the reads.
+ */
+static int record(const char *path, unsigned long cycles, unsigned long devices)
+{
+    MiniModbusCapture_t capture;
+    if (MiniModbus_CaptureCreate(&capture, path, 4096) != MiniModbusError_Success) {
+        perror(path);
+        return 1;
+    }
+
+    MiniModbusSim_t sim;
+    MiniModbusSim_Init(&sim, MiniModbusMode_TCP, 1, registers, REGISTER_COUNT);
+    sim.exception_rate_ppm = 10000;
+
+    MiniModbusConfig_t config;
+    MiniModbusSim_Config(&sim, &config);
+    MiniModbusContext_t ctx;
+    MiniModbus_Init(&ctx, &config);
+
+    uint16_t values[BLOCK_SIZE];
+    unsigned long failed = 0;
+    for (unsigned long cycle = 0; cycle < cycles; cycle++) {
+        for (unsigned long device = 0; device < devices; device++) {
+            uint16_t address = (device * BLOCK_SIZE) % (REGISTER_COUNT - BLOCK_SIZE);
+            for (uint16_t i = 0; i < BLOCK_SIZE; i++) {
+                registers[address + i] = cycle + i;
+            }
+            if (MiniModbus_CaptureRead(&capture, &ctx, device, 0x03, address, BLOCK_SIZE, values) !=
+                MiniModbusError_Success) {
+                failed++;
+            }
+        }
+    }
+
+    printf("%lu reads (%lu failed), %" PRIu64 " records\n", cycles * devices, failed, MiniModbus_CaptureHead(&capture));
+    MiniModbus_CaptureClose(&capture);
+
+    return 0;
+}
+
+static int dump(const char *path, int follow)
+{
+    MiniModbusCapture_t capture;
+    if (MiniModbus_CaptureOpen(&capture, path) != MiniModbusError_Success) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return 1;
+    }
+
+    uint64_t head = MiniModbus_CaptureHead(&capture);
+    uint64_t sequence = follow ? head : MiniModbus_CaptureOldest(&capture, head);
+    do {
+        sequence = print_records(&capture, sequence, head);
+        if (follow) {
+            fflush(stdout);
+
+            // reading the head is just a load from the mapping: sleeping is only to not spin
+            struct timespec delay = {.tv_nsec = 1000000};
+            while ((head = MiniModbus_CaptureHead(&capture)) == sequence) {
+                nanosleep(&delay, NULL);
+            }
+        }
+    } while (follow);
+
+    MiniModbus_CaptureClose(&capture);
+
+    return 0;
+}
+
+/*
+ * Feed the captured values back through the simulated transport: the registers of the simulated slave take the
+ * values of each record in turn, and are read back with the library. Failed reads are replayed too, as a lost
+ * response (transport errors) or as an exception.
+ */
+static int replay(const char *path, long device)
+{
+    MiniModbusCapture_t capture;
+    if (MiniModbus_CaptureOpen(&capture, path) != MiniModbusError_Success) {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return 1;
+    }
+
+    MiniModbusSim_t sim;
+    MiniModbusSim_Init(&sim, MiniModbusMode_RTU, 1, registers, REGISTER_COUNT);
+
+    MiniModbusConfig_t config;
+    MiniModbusSim_Config(&sim, &config);
+    MiniModbusContext_t ctx;
+    MiniModbus_Init(&ctx, &config);
+
+    uint64_t head = MiniModbus_CaptureHead(&capture);
+    unsigned long replayed = 0;
+    unsigned long mismatches = 0;
+    unsigned long skipped = 0;
+    uint16_t values[MINI_MODBUS_CAPTURE_WORDS];
+    for (uint64_t sequence = MiniModbus_CaptureOldest(&capture, head); sequence < head; sequence++) {
+        const MiniModbusCaptureRecord_t *record = MiniModbus_CaptureRecord(&capture, sequence);
+        if (record == NULL) {
+            skipped++;
+            continue;
+        }
+
+        MiniModbusCaptureRecord_t copy = *record;
+        if (!MiniModbus_CaptureValid(record, sequence)) {
+            skipped++;
+            continue;
+        }
+        if ((device >= 0 && copy.device != device) || copy.count == 0 || copy.count > MINI_MODBUS_CAPTURE_WORDS ||
+            copy.address + copy.count > REGISTER_COUNT) {
+            continue;
+        }
+
+        sim.drop_rate_ppm = copy.error < 0 ? 1000000 : 0;
+        sim.exception_rate_ppm = copy.error > 0 ? 1000000 : 0;
+        memcpy(&registers[copy.address], copy.values, copy.count * sizeof(uint16_t));
+
+        MiniModbusError_t error;
+        if (copy.function_code == 0x04) {
+            error = MiniModbus_ReadInputRegisters(&ctx, copy.address, copy.count, values);
+        } else {
+            error = MiniModbus_ReadHoldingRegisters(&ctx, copy.address, copy.count, values);
+        }
+
+        // the kind of failure is replayed, not the exact error code
+        if ((error == MiniModbusError_Success) != (copy.error == MiniModbusError_Success) ||
+            (error == MiniModbusError_Success && memcmp(values, copy.values, copy.count * sizeof(uint16_t)) != 0)) {
+            mismatches++;
+        }
+        replayed++;
+    }
+
+    printf("%lu records replayed, %lu mismatches, %lu overwritten while reading\n", replayed, mismatches, skipped);
+    MiniModbus_CaptureClose(&capture);
+
+    return mismatches != 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        usage();
+    }
+
+    if (strcmp(argv[1], "record") == 0) {
+        return record(argv[2], argc > 3 ? strtoul(argv[3], NULL, 10) : 100, argc > 4 ? strtoul(argv[4], NULL, 10) : 10);
+    }
+    if (strcmp(argv[1], "dump") == 0) {
+        return dump(argv[2], 0);
+    }
+    if (strcmp(argv[1], "follow") == 0) {
+        return dump(argv[2], 1);
+    }
+    if (strcmp(argv[1], "replay") == 0) {
+        return replay(argv[2], argc > 3 ? strtol(argv[3], NULL, 10) : -1);
+    }
+    usage();
+
+    return 2;
+}
@@ -0,0 +1,210 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "include/minimodbus_bridge.h"
+#include "include/minimodbus_sim.h"
+
+#define REGISTER_COUNT 1000
+#define BLOCK_SIZE 10
+
+static volatile int running = 1;
+static uint32_t baud_rate;
+static uint16_t port;
+static MiniModbusSim_t slave;
+static int serial_fd[2];
+
+static unsigned long transactions;
+static unsigned long failures;
+static pthread_mutex_t counters_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * The other end of the serial line: a RTU slave that takes as long as the frames take on the wire.
+ */
+static void *slave_thread(void *arg)
+{
+    uint8_t request[MINI_MODBUS_MAX_FRAME_SIZE];
+    uint8_t response[MINI_MODBUS_MAX_FRAME_SIZE];
+    size_t received = 0;
+    (void)arg;
+
+    for (;;) {
+        ssize_t result = read(serial_fd[1], request + received, sizeof(request) - received);
+        if (result <= 0) {
+            return NULL;
+        }
+        received += result;
+
+        size_t length = MiniModbus_FrameLength(MiniModbusMode_RTU, 1, request, received);
+        while (length != 0 && received >= length) {
+            size_t response_length = 0;
+            MiniModbus_ServerHandleFrame(&slave.server, request, length, response, &response_length);
+
+            struct timespec delay = {.tv_nsec = (long)(length + response_length) * 11 * 1000000 / baud_rate * 1000};
+            nanosleep(&delay, NULL);
+            if (response_length > 0 && write(serial_fd[1], response, response_length) < 0) {
+                return NULL;
+            }
+
+            memmove(request, request + length, received - length);
+            received -= length;
+            length = MiniModbus_FrameLength(MiniModbusMode_RTU, 1, request, received);
+        }
+        if (length == 0) {
+            received = 0;
+        }
+    }
+}
+
+static int tcp_send(void *user_data, const void *data, size_t length)
+{
+    return send(*(int *)user_data, data, length, MSG_NOSIGNAL);
+}
+
+static int tcp_receive(void *user_data, void *data, size_t length)
+{
+    return recv(*(int *)user_data, data, length, MSG_WAITALL);
+}
+
+/*
+ * A TCP client. Most clients read the same block, as dashboards showing the same values do, and the bridge reads it
+ * once for all of them. One client in four reads a block of its own.
+ */
+static void *client_thread(void *arg)
+{
+    size_t id = (size_t)arg;
+    uint16_t reg = id % 4 == 0 ? (id * BLOCK_SIZE) % (REGISTER_COUNT - BLOCK_SIZE) : 0;
+    uint16_t values[BLOCK_SIZE];
+    unsigned long done = 0;
+    unsigned long failed = 0;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr.s_addr);
+    if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+
+    MiniModbusContext_t ctx;
+    MiniModbusConfig_t config = {
+        .mode = MiniModbusMode_TCP,
+        .slave_address = 1,
+        .user_data = &fd,
+        .send = tcp_send,
+        .receive = tcp_receive,
+    };
+    MiniModbus_Init(&ctx, &config);
+
+    while (running) {
+        MiniModbusError_t error = MiniModbus_ReadHoldingRegisters(&ctx, reg, BLOCK_SIZE, values);
+        if (error != MiniModbusError_Success || values[0] != reg) {
+            failed++;
+        }
+        done++;
+    }
+    close(fd);
+
+    pthread_mutex_lock(&counters_lock);
+    transactions += done;
+    failures += failed;
+    pthread_mutex_unlock(&counters_lock);
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    size_t client_count = argc > 1 ? strtoul(argv[1], NULL, 10) : 50;
+    unsigned seconds = argc > 2 ? strtoul(argv[2], NULL, 10) : 3;
+    baud_rate = argc > 3 ? strtoul(argv[3], NULL, 10) : 115200;
+
+    // a simulated RTU slave with 1000 holding registers, value = address, behind a socket pair as serial line
+    static uint16_t registers[REGISTER_COUNT];
+    for (size_t i = 0; i < REGISTER_COUNT; i++) {
+        registers[i] = i;
+    }
+    MiniModbusSim_Init(&slave, MiniModbusMode_RTU, 1, registers, REGISTER_COUNT);
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, serial_fd) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    pthread_t slave_id;
+    pthread_create(&slave_id, NULL, slave_thread, NULL);
+
+    int listen_fd = MiniModbusSim_TcpListen(0, &port);
+    if (listen_fd < 0) {
+        perror("listen");
+        exit(1);
+    }
+
+    MiniModbusBridge_t bridge;
+    MiniModbusBridgeLine_t line;
+    MiniModbusBridgeClient_t *clients = calloc(client_count, sizeof(MiniModbusBridgeClient_t));
+    MiniModbusBridgeRequest_t *requests = calloc(client_count, sizeof(MiniModbusBridgeRequest_t));
+
+    MiniModbus_BridgeInit(&bridge, clients, client_count, requests, client_count);
+    MiniModbus_BridgeLineInit(&line, serial_fd[0], baud_rate, 1, 247);
+    MiniModbus_BridgeAddLine(&bridge, &line);
+    if (MiniModbus_BridgeStart(&bridge, listen_fd) != MiniModbusError_Success) {
+        fprintf(stderr, "can't start the bridge\n");
+        exit(1);
+    }
+
+    pthread_t *threads = calloc(client_count, sizeof(pthread_t));
+    for (size_t i = 0; i < client_count; i++) {
+        pthread_create(&threads[i], NULL, client_thread, (void *)i);
+    }
+    sleep(seconds);
+    running = 0;
+    for (size_t i = 0; i < client_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    MiniModbus_BridgeStop(&bridge);
+    close(serial_fd[0]);
+    pthread_join(slave_id, NULL);
+
+    printf("%zu clients, %u bps: %lu transactions (%lu failed), %.0f/s\n", client_count, baud_rate, transactions,
+           failures, (double)transactions / seconds);
+    printf("serial line: %lu requests, %lu coalesced, %lu timeouts, %lu errors\n", line.requests, line.coalesced,
+           line.timeouts, line.errors);
+
+    free(threads);
+    free(requests);
+    free(clients);
+    close(listen_fd);
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "include/minimodbus_coro.hpp"
+#include "include/minimodbus_sim.h"
+
+#define REGISTER_COUNT 1000
+
+static volatile int slave_running = 1;
+static MiniModbusSim_t slave;
+static int listen_fd;
+
+struct Totals {
+    size_t sessions;
+    size_t finished;
+    unsigned long completed;
+    unsigned long failed;
+};
+
+static void *slave_thread(void *)
+{
+    MiniModbusSim_TcpServe(&slave.server, listen_fd, 65536, &slave_running);
+    return nullptr;
+}
+
+static int connect_to(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    return fd;
+}
+
+// a device session: read a block, check it, write a register, for a number of rounds
+static minimodbus::Task session(minimodbus::EventLoop &loop, minimodbus::Client &client, uint16_t first,
+                                unsigned rounds, Totals &totals)
+{
+    uint16_t values[10];
+
+    for (unsigned i = 0; i < rounds; i++) {
+        MiniModbusError_t error = co_await client.ReadHoldingRegisters(first, 10, values);
+        if (error == MiniModbusError_Success && values[9] == first + 9) {
+            totals.completed++;
+        } else {
+            totals.failed++;
+        }
+
+        error = co_await client.WriteSingleRegister(REGISTER_COUNT - 1, i);
+        if (error == MiniModbusError_Success) {
+            totals.completed++;
+        } else {
+            totals.failed++;
+        }
+    }
+
+    if (++totals.finished == totals.sessions) {
+        loop.Stop();
+    }
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t session_count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000;
+    unsigned rounds = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100;
+
+    // a simulated slave with 1000 holding registers, value = address
+    static uint16_t registers[REGISTER_COUNT];
+    for (size_t i = 0; i < REGISTER_COUNT; i++) {
+        registers[i] = i;
+    }
+    MiniModbusSim_Init(&slave, MiniModbusMode_TCP, 1, registers, REGISTER_COUNT);
+
+    uint16_t port;
+    listen_fd = MiniModbusSim_TcpListen(0, &port);
+    if (listen_fd < 0) {
+        perror("listen");
+        exit(1);
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, nullptr, slave_thread, nullptr);
+
+    minimodbus::EventLoop loop;
+    if (!loop.Valid()) {
+        perror("epoll");
+        exit(1);
+    }
+
+    std::vector<std::unique_ptr<minimodbus::Client>> clients;
+    for (size_t i = 0; i < session_count; i++) {
+        int fd = connect_to(port);
+        if (fd < 0) {
+            perror("connect");
+            exit(1);
+        }
+        clients.push_back(std::make_unique<minimodbus::Client>(loop, MiniModbusMode_TCP, 1));
+        clients.back()->Attach(fd);
+    }
+
+    // all the sessions run on this thread
+    Totals totals = {session_count, 0, 0, 0};
+    double start = now_seconds();
+    for (size_t i = 0; i < session_count; i++) {
+        session(loop, *clients[i], (i * 10) % (REGISTER_COUNT - 10), rounds, totals);
+    }
+    loop.Run();
+    double elapsed = now_seconds() - start;
+
+    printf("%zu sessions, %lu transactions, %lu failed, %.0f transactions/s\n", session_count, totals.completed,
+           totals.failed, (totals.completed + totals.failed) / elapsed);
+
+    slave_running = 0;
+    pthread_join(thread, nullptr);
+
+    return totals.failed == 0 ? 0 : 1;
+}
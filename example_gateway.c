@@ -0,0 +1,143 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+
+#include "include/minimodbus_gateway.h"
+#include "include/minimodbus_sim.h"
+
+#define POINTS_PER_DEVICE 16
+
+static volatile int slave_running = 1;
+static MiniModbusSim_t slave;
+static int listen_fd;
+
+static void *slave_thread(void *arg)
+{
+    (void)arg;
+    MiniModbusSim_TcpServe(&slave.server, listen_fd, 1024, &slave_running);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    size_t device_count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+    size_t worker_count = argc > 2 ? strtoul(argv[2], NULL, 10) : 2;
+    unsigned seconds = argc > 3 ? strtoul(argv[3], NULL, 10) : 3;
+
+    // a simulated slave with 1000 holding registers, value = address
+    static uint16_t registers[1000];
+    for (size_t i = 0; i < 1000; i++) {
+        registers[i] = i;
+    }
+    MiniModbusSim_Init(&slave, MiniModbusMode_TCP, 1, registers, 1000);
+
+    uint16_t port;
+    listen_fd = MiniModbusSim_TcpListen(0, &port);
+    if (listen_fd < 0) {
+        perror("listen");
+        exit(1);
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, slave_thread, NULL);
+
+    MiniModbusGateway_t gateway;
+    MiniModbusGatewayWorker_t *workers = calloc(worker_count, sizeof(MiniModbusGatewayWorker_t));
+    MiniModbusGatewayDevice_t *devices = calloc(device_count, sizeof(MiniModbusGatewayDevice_t));
+    MiniModbusPollPlan_t *plans = calloc(device_count, sizeof(MiniModbusPollPlan_t));
+    MiniModbusPollPoint_t *points = calloc(device_count * POINTS_PER_DEVICE, sizeof(MiniModbusPollPoint_t));
+    MiniModbusPollBlock_t *blocks = calloc(device_count * POINTS_PER_DEVICE, sizeof(MiniModbusPollBlock_t));
+    uint16_t *values = calloc(device_count * POINTS_PER_DEVICE, sizeof(uint16_t));
+
+    MiniModbus_GatewayInit(&gateway, workers, worker_count, 1);
+
+    for (size_t i = 0; i < device_count; i++) {
+        MiniModbusGatewayDevice_t *device = &devices[i];
+        MiniModbusContext_t *ctx = MiniModbus_GatewayDeviceInit(device, 1);
+
+        struct sockaddr_in *addr = (struct sockaddr_in *)&device->address;
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &addr->sin_addr.s_addr);
+        device->address_length = sizeof(struct sockaddr_in);
+        device->period_ms = 100;
+
+        // scattered registers, that the plan reads with a few blocks
+        MiniModbusPollPoint_t *device_points = &points[i * POINTS_PER_DEVICE];
+        for (size_t j = 0; j < POINTS_PER_DEVICE; j++) {
+            device_points[j].address = (i + j * 37) % 1000;
+            device_points[j].value = &values[i * POINTS_PER_DEVICE + j];
+        }
+        if (MiniModbus_PollPlanBuild(ctx, &plans[i], MiniModbusTable_HoldingRegisters, device_points,
+                                     POINTS_PER_DEVICE, NULL, &blocks[i * POINTS_PER_DEVICE],
+                                     POINTS_PER_DEVICE) != MiniModbusError_Success) {
+            fprintf(stderr, "cannot build the plan of device %zu\n", i);
+            exit(1);
+        }
+        device->plan = &plans[i];
+
+        MiniModbus_GatewayAddDevice(&gateway, device);
+    }
+
+    if (MiniModbus_GatewayStart(&gateway) != MiniModbusError_Success) {
+        fprintf(stderr, "cannot start the gateway\n");
+        exit(1);
+    }
+    sleep(seconds);
+    MiniModbus_GatewayStop(&gateway);
+
+    slave_running = 0;
+    pthread_join(thread, NULL);
+    close(listen_fd);
+
+    unsigned long cycles = 0, failed = 0, connects = 0, wrong = 0;
+    for (size_t i = 0; i < device_count; i++) {
+        cycles += devices[i].cycles;
+        failed += devices[i].failed_cycles;
+        connects += devices[i].connects;
+        for (size_t j = 0; j < POINTS_PER_DEVICE; j++) {
+            MiniModbusPollPoint_t *point = &points[i * POINTS_PER_DEVICE + j];
+            wrong += *point->value != point->address;
+        }
+    }
+
+    printf("%zu devices, %zu workers, %u s: %lu cycles (%.0f/s), %lu failed, %lu connects, %lu wrong values\n",
+           device_count, worker_count, seconds, cycles, (double)cycles / seconds, failed, connects, wrong);
+
+    free(values);
+    free(blocks);
+    free(points);
+    free(plans);
+    free(devices);
+    free(workers);
+
+    return failed == 0 && wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "include/minimodbus_queue.h"
+#include "include/minimodbus_sim.h"
+
+#define REGISTER_COUNT 1024
+#define BLOCK_SIZE 8
+#define SLOT_COUNT 256
+
+typedef enum Mode {
+    Mode_Mutex,
+    Mode_Wait,
+    Mode_Callback,
+} Mode_t;
+
+static const char *mode_names[] = {"global mutex", "queue, wait", "queue, callback"};
+
+static uint16_t registers[REGISTER_COUNT];
+static MiniModbusContext_t ctx;
+static MiniModbusQueue_t queue;
+static pthread_mutex_t ctx_lock = PTHREAD_MUTEX_INITIALIZER;
+static Mode_t mode;
+static size_t requests_per_thread;
+static unsigned long failures;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void check(uint16_t reg, const uint16_t *values, MiniModbusError_t error)
+{
+    if (error != MiniModbusError_Success || values[0] != reg) {
+        __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Callback mode: each thread keeps a few jobs in flight, and the callback submits each one again till the thread
+ * reaches its count.
+ */
+typedef struct Stream {
+    MiniModbusQueueJob_t jobs[4];
+    uint16_t values[4][BLOCK_SIZE];
+    size_t submitted;
+    size_t completed;
+} Stream_t;
+
+static void on_complete(MiniModbusQueueJob_t *job)
+{
+    Stream_t *stream = job->user_data;
+
+    check(job->reg, job->values, job->result);
+    if (stream->submitted < requests_per_thread) {
+        stream->submitted++;
+        while (MiniModbus_QueueSubmit(&queue, job) == MiniModbusError_QueueFull) {
+        }
+    }
+    __atomic_fetch_add(&stream->completed, 1, __ATOMIC_RELEASE);
+}
+
+static void *worker_thread(void *arg)
+{
+    uint16_t reg = (size_t)arg * BLOCK_SIZE % REGISTER_COUNT;
+    uint16_t values[BLOCK_SIZE];
+
+    if (mode == Mode_Callback) {
+        Stream_t stream = {0};
+        for (size_t i = 0; i < 4 && stream.submitted < requests_per_thread; i++) {
+            MiniModbusQueueJob_t *job = &stream.jobs[i];
+            *job = (MiniModbusQueueJob_t){.function_code = 0x03, .reg = reg, .quantity = BLOCK_SIZE,
+                                          .values = stream.values[i], .callback = on_complete, .user_data = &stream};
+            stream.submitted++;
+            while (MiniModbus_QueueSubmit(&queue, job) == MiniModbusError_QueueFull) {
+            }
+        }
+        while (__atomic_load_n(&stream.completed, __ATOMIC_ACQUIRE) < stream.submitted) {
+            sched_yield();
+        }
+        return NULL;
+    }
+
+    for (size_t i = 0; i < requests_per_thread; i++) {
+        MiniModbusError_t error;
+        if (mode == Mode_Mutex) {
+            pthread_mutex_lock(&ctx_lock);
+            error = MiniModbus_ReadHoldingRegisters(&ctx, reg, BLOCK_SIZE, values);
+            pthread_mutex_unlock(&ctx_lock);
+        } else {
+            MiniModbusQueueJob_t job = {.function_code = 0x03, .reg = reg, .quantity = BLOCK_SIZE, .values = values};
+            error = MiniModbus_QueueExecute(&queue, &job);
+        }
+        check(reg, values, error);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    size_t thread_count = argc > 1 ? strtoul(argv[1], NULL, 10) : 8;
+    requests_per_thread = argc > 2 ? strtoul(argv[2], NULL, 10) : 20000;
+    uint32_t latency_us = argc > 3 ? strtoul(argv[3], NULL, 10) : 0;
+
+    for (size_t i = 0; i < REGISTER_COUNT; i++) {
+        registers[i] = i;
+    }
+
+    // one simulated slave, shared by all the threads through one context
+    MiniModbusSim_t sim;
+    MiniModbusSim_Init(&sim, MiniModbusMode_TCP, 1, registers, REGISTER_COUNT);
+    sim.latency_us = latency_us;
+    MiniModbusConfig_t config;
+    MiniModbusSim_Config(&sim, &config);
+    MiniModbus_Init(&ctx, &config);
+
+    static MiniModbusQueueSlot_t slots[SLOT_COUNT];
+    MiniModbus_QueueInit(&queue, &ctx, slots, SLOT_COUNT);
+
+    pthread_t *threads = calloc(thread_count, sizeof(pthread_t));
+    printf("%zu threads, %zu requests each, slave latency %u us\n", thread_count, requests_per_thread, latency_us);
+
+    for (mode = Mode_Mutex; mode <= Mode_Callback; mode++) {
+        failures = 0;
+        if (mode != Mode_Mutex) {
+            MiniModbus_QueueStart(&queue);
+        }
+
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < thread_count; i++) {
+            pthread_create(&threads[i], NULL, worker_thread, (void *)i);
+        }
+        for (size_t i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        double seconds = (now_ns() - start) / 1e9;
+
+        if (mode != Mode_Mutex) {
+            MiniModbus_QueueStop(&queue);
+        }
+        printf("%-16s %10.0f requests/s, %lu failed\n", mode_names[mode], thread_count * requests_per_thread / seconds,
+               failures);
+    }
+    printf("I/O thread slept %lu times\n", queue.sleeps);
+
+    free(threads);
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "include/minimodbus.hpp"
+#include "include/minimodbus_sim.h"
+
+// register map of an energy meter
+namespace energy_meter {
+
+using Voltage = minimodbus::Register<0, float, MiniModbusWordOrder_CDAB>;
+using Current = minimodbus::Register<2, float, MiniModbusWordOrder_CDAB>;
+using Status = minimodbus::Register<4, uint16_t>;
+using Energy = minimodbus::Register<10, uint64_t>;
+using Setpoint = minimodbus::Register<20, int32_t>;
+
+using Measures = minimodbus::Block<MiniModbusTable_InputRegisters, Voltage, Current, Status, Energy>;
+
+} // namespace energy_meter
+
+using Meter = minimodbus::Device<MiniModbusMode_RTU, 1>;
+
+// the request is ready before the program runs
+static_assert(energy_meter::Measures::frame<MiniModbusMode_RTU, 1>.length == 8, "an RTU read request is 8 bytes");
+
+int main()
+{
+    // a simulated meter: its registers are both holding and input registers
+    static uint16_t registers[32];
+    MiniModbusSim_t sim;
+    MiniModbusSim_Init(&sim, MiniModbusMode_RTU, 1, registers, 32);
+
+    MiniModbusConfig_t config;
+    MiniModbusSim_Config(&sim, &config);
+
+    MiniModbusContext_t ctx;
+    MiniModbus_Init(&ctx, &config);
+
+    Meter meter(&ctx);
+    meter.Write<energy_meter::Voltage>(230.4f);
+    meter.Write<energy_meter::Current>(1.25f);
+    meter.Write<energy_meter::Energy>(1234567);
+    meter.Write<energy_meter::Setpoint>(-40);
+
+    energy_meter::Measures::Values values;
+    MiniModbusError_t error = meter.Read<energy_meter::Measures>(values);
+    if (error != MiniModbusError_Success) {
+        fprintf(stderr, "read failed: %d\n", error);
+        exit(1);
+    }
+
+    printf("voltage %.1f V, current %.2f A, status %u, energy %llu Wh\n", values.Get<energy_meter::Voltage>(),
+           values.Get<energy_meter::Current>(), values.Get<energy_meter::Status>(),
+           static_cast<unsigned long long>(values.Get<energy_meter::Energy>()));
+
+    return 0;
+}
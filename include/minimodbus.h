@@ -40,7 +40,54 @@ extern "C" {
 #include <stddef.h>
 #include <stdint.h>
 
+#ifndef MINI_MODBUS_BUFFER_SIZE
 #define MINI_MODBUS_BUFFER_SIZE 256
+#endif /* MINI_MODBUS_BUFFER_SIZE */
+
+/**
+ * Maximum size of a Modbus frame (a TCP frame, MBAP header included). Used for the server buffers, since a server
+ * has to accept any request a compliant client can send.
+ */
+#define MINI_MODBUS_MAX_FRAME_SIZE 260
+
+/**
+ * Size of the buffer of a buffered transport (see MiniModbus_BufferedTransportInit()). Must be at least
+ * MINI_MODBUS_MAX_FRAME_SIZE: a larger buffer keeps more frames when the peer sends them back to back.
+ */
+#ifndef MINI_MODBUS_RECEIVE_BUFFER_SIZE
+#define MINI_MODBUS_RECEIVE_BUFFER_SIZE 512
+#endif /* MINI_MODBUS_RECEIVE_BUFFER_SIZE */
+
+/**
+ * Maximum number of registers that can be read with a single request, as defined by the Modbus standard.
+ * Note that in TCP mode, with the default buffer size, the limit is lower (123 registers) since the full response
+ * (MBAP header included) has to fit into the context buffer. Define MINI_MODBUS_BUFFER_SIZE to 260 to lift it.
+ */
+#define MINI_MODBUS_MAX_READ_REGISTERS 125
+
+/**
+ * Maximum number of registers that can be written with a single request, as defined by the Modbus standard.
+ * As for reads, the full request has to fit into the context buffer: with the default buffer size the limit is
+ * 121 registers in TCP mode.
+ */
+#define MINI_MODBUS_MAX_WRITE_REGISTERS 123
+
+/**
+ * Maximum number of registers that can be written with a single read/write multiple registers request.
+ */
+#define MINI_MODBUS_MAX_READ_WRITE_REGISTERS 121
+
+/**
+ * Maximum number of coils or discrete inputs that can be read with a single request, as defined by the Modbus
+ * standard. With the default buffer size the limit is 1976 in TCP mode.
+ */
+#define MINI_MODBUS_MAX_READ_BITS 2000
+
+/**
+ * Maximum number of coils that can be written with a single request, as defined by the Modbus standard.
+ * With the default buffer size the limit is 1944 in TCP mode.
+ */
+#define MINI_MODBUS_MAX_WRITE_BITS 1968
 
 /**
  * MiniModbus error code.
@@ -73,8 +120,38 @@ typedef enum MiniModbusError {
     MiniModbusError_ResponseInvalidTransactionIdentifier = -11,
     MiniModbusError_ResponseInvalidProtocolIdentifier = -12,
     MiniModbusError_ResponseInvalidLength = -13,
+    MiniModbusError_Pending = -14,
+    MiniModbusError_Timeout = -15,
+    MiniModbusError_QueueFull = -16,
 } MiniModbusError_t;
 
+/**
+ * Number of library error codes, 0 included. Keep in sync with the most negative code above.
+ */
+#define MINI_MODBUS_ERROR_COUNT (1 - MiniModbusError_QueueFull)
+
+/**
+ * Implementations of the CRC16 used by RTU frames.
+ * Only the byte at a time table is available by default: define MINI_MODBUS_FAST_CRC when building the library to
+ * enable the faster ones, at the cost of 4 KiB of tables. Not meant for microcontrollers.
+ */
+typedef enum MiniModbusCrc {
+    /**
+     * byte at a time lookup in a 256 entries table
+     */
+    MiniModbusCrc_Table = 0,
+
+    /**
+     * slicing-by-8 lookup, 8 bytes at a time (requires MINI_MODBUS_FAST_CRC)
+     */
+    MiniModbusCrc_Slicing8 = 1,
+
+    /**
+     * carry-less multiplication (requires MINI_MODBUS_FAST_CRC and a x86-64 CPU with PCLMULQDQ)
+     */
+    MiniModbusCrc_Clmul = 2,
+} MiniModbusCrc_t;
+
 /**
  * Modbus mode of operation
  */
@@ -90,6 +167,40 @@ typedef enum MiniModbusMode {
     MiniModbusMode_TCP = 1,
 } MiniModbusMode_t;
 
+/**
+ * Order of the bytes of a 32 or 64 bit value stored in consecutive registers, for the value 0xAABBCCDD (for 64 bit
+ * values, the order of the words is reversed as a whole).
+ */
+typedef enum MiniModbusWordOrder {
+    /**
+     * big endian: most significant word first, most significant byte first in each word (Modbus standard order)
+     */
+    MiniModbusWordOrder_ABCD = 0,
+
+    /**
+     * word swapped: least significant word first
+     */
+    MiniModbusWordOrder_CDAB = 1,
+
+    /**
+     * byte swapped: most significant word first, least significant byte first in each word
+     */
+    MiniModbusWordOrder_BADC = 2,
+
+    /**
+     * little endian: least significant word first, least significant byte first in each word
+     */
+    MiniModbusWordOrder_DCBA = 3,
+} MiniModbusWordOrder_t;
+
+/**
+ * A buffer of data to send, part of a scatter/gather send (see sendv in MiniModbusConfig_t).
+ */
+typedef struct MiniModbusIoVec {
+    const void *data;
+    size_t length;
+} MiniModbusIoVec_t;
+
 /**
  * MiniModbus configuration structure
  */
@@ -134,17 +245,297 @@ typedef struct MiniModbusConfig {
      *         (that should always be the same of length)
      */
     int (*send)(void *user_data, const void *data, size_t length);
+
+    /**
+     * optional function to send data from more buffers at once, as writev(2). Used in TCP mode to send pre-encoded
+     * frames (see MiniModbus_FrameExecute()) without copying them. Can be NULL.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     * @param iov buffers to send, in order
+     * @param iov_count number of buffers
+     * @return an value < 0 in case of an error, otherwise the total number of bytes sent
+     */
+    int (*sendv)(void *user_data, const MiniModbusIoVec_t *iov, size_t iov_count);
+
+    /**
+     * optional function to receive data with a timeout, used instead of receive to wait the responses when
+     * timeout_us is set. Like receive it should block till the specified amount of data is received, but not longer
+     * than timeout_us. Can be NULL.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     * @param data pointer to a buffer where to store the received data
+     * @param length number of bytes to receive
+     * @param timeout_us maximum time to wait, in microseconds
+     * @return a value < 0 in case of error, otherwise the number of bytes received (less than length if the timeout
+     *         expired)
+     */
+    int (*receive_timeout)(void *user_data, void *data, size_t length, uint32_t timeout_us);
+
+    /**
+     * optional function to discard the data received and not read yet, as tcflush(3) with TCIFLUSH. Called after a
+     * timeout or a corrupted response, so that partial frames and late responses don't get mixed with the next
+     * response. Can be NULL.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     */
+    void (*flush)(void *user_data);
+
+    /**
+     * optional monotonic clock, in microseconds. It may wrap around. Used for the deadline of the responses, the
+     * adaptive timeout and the latency histograms. If NULL each receive_timeout call gets the whole timeout.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     * @return the current time in microseconds
+     */
+    uint32_t (*clock)(void *user_data);
+
+    /**
+     * maximum time to wait a response, in microseconds, from the end of the request. 0 to wait as long as the
+     * receive callback does. Requires receive_timeout.
+     */
+    uint32_t timeout_us;
+
+    /**
+     * if not 0, the timeout adapts to the response times of the slave (as the TCP retransmission timeout), between
+     * this value and timeout_us, in microseconds. Requires clock.
+     */
+    uint32_t timeout_min_us;
+
+    /**
+     * number of times a request is sent again after a timeout or a corrupted response. Exceptions from the slave are
+     * not retried.
+     */
+    uint8_t retries;
+
+#ifdef MINI_MODBUS_STATS
+    /**
+     * optional trace hook, called with each request frame before it's sent. Can be NULL.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     * @param frame the request frame
+     * @param length length of the frame
+     */
+    void (*trace_send)(void *user_data, const uint8_t *frame, size_t length);
+
+    /**
+     * optional trace hook, called with each response frame after it's received, or after receiving it failed.
+     * Can be NULL.
+     *
+     * @param user_data pointer to the custom user_data if specified in config
+     * @param frame the bytes received
+     * @param length number of bytes received, can be less than a full frame in case of error
+     * @param result result of the validation of the frame (slave address, CRC, length, exception)
+     */
+    void (*trace_receive)(void *user_data, const uint8_t *frame, size_t length, MiniModbusError_t result);
+#endif /* MINI_MODBUS_STATS */
 } MiniModbusConfig_t;
 
+/**
+ * A pipelined TCP transaction. The object is owned by the caller and must stay valid until the transaction
+ * completes. It must be zero initialized before its first use, and can be reused once it's completed.
+ */
+typedef struct MiniModbusTransaction {
+    /**
+     * function called when the response for the transaction is received, or the transaction is aborted.
+     * Can be NULL. It's safe to submit new transactions (including this one) from the callback.
+     *
+     * @param transaction the completed transaction
+     */
+    void (*callback)(struct MiniModbusTransaction *transaction);
+
+    /**
+     * a pointer to data that may be used in the callback
+     */
+    void *user_data;
+
+    /**
+     * result of the transaction: MiniModbusError_Pending till the response is received
+     */
+    MiniModbusError_t result;
+
+    /* private fields, used to match and decode the response */
+    struct MiniModbusTransaction *next;
+    uint16_t *values;
+    uint16_t transaction_identifier;
+    uint16_t address;
+    uint16_t quantity;
+    uint8_t function_code;
+    uint8_t response_length;
+} MiniModbusTransaction_t;
+
+/**
+ * Modbus data tables
+ */
+typedef enum MiniModbusTable {
+    MiniModbusTable_Coils = 0,
+    MiniModbusTable_DiscreteInputs = 1,
+    MiniModbusTable_InputRegisters = 2,
+    MiniModbusTable_HoldingRegisters = 3,
+} MiniModbusTable_t;
+
+/**
+ * A register to poll with a poll plan.
+ */
+typedef struct MiniModbusPollPoint {
+    /**
+     * address of the register (zero based)
+     */
+    uint16_t address;
+
+    /**
+     * where to store the value of the register
+     */
+    uint16_t *value;
+} MiniModbusPollPoint_t;
+
+/**
+ * A range of registers
+ */
+typedef struct MiniModbusRange {
+    uint16_t start;
+    uint16_t count;
+} MiniModbusRange_t;
+
+/**
+ * Device specific limits for a poll plan. A zero initialized object means no gaps are read and blocks can be as
+ * long as the context buffer allows.
+ */
+typedef struct MiniModbusPollLimits {
+    /**
+     * maximum number of registers read by a single request, 0 for the maximum the context buffer allows
+     */
+    uint16_t max_quantity;
+
+    /**
+     * maximum number of unwanted registers that can be read to merge two blocks in a single request.
+     * Reading a few more registers is usually cheaper than another round trip.
+     */
+    uint16_t max_gap;
+
+    /**
+     * ranges of registers that must never be read (for example because the device answers with an exception)
+     */
+    const MiniModbusRange_t *holes;
+
+    /**
+     * number of elements of holes
+     */
+    size_t hole_count;
+} MiniModbusPollLimits_t;
+
+/**
+ * A block read of a poll plan
+ */
+typedef struct MiniModbusPollBlock {
+    /**
+     * first register and number of registers read
+     */
+    uint16_t start;
+    uint16_t quantity;
+
+    /**
+     * points served by this block, as a range in the (sorted) points of the plan
+     */
+    size_t first_point;
+    size_t point_count;
+
+    /**
+     * result of the last execution of the block
+     */
+    MiniModbusError_t result;
+} MiniModbusPollBlock_t;
+
+/**
+ * A poll plan: the minimal set of block reads to fetch a set of registers. It's built once, and then can be executed
+ * every poll cycle. Points and blocks are owned by the caller.
+ */
+typedef struct MiniModbusPollPlan {
+    MiniModbusPollPoint_t *points;
+    size_t point_count;
+    MiniModbusPollBlock_t *blocks;
+    size_t block_count;
+    uint8_t function_code;
+} MiniModbusPollPlan_t;
+
+#ifdef MINI_MODBUS_STATS
+
+/**
+ * Number of buckets of the latency histograms. Bucket 0 counts latencies of 0 us, bucket i latencies from 2^(i-1) to
+ * 2^i - 1 us, and the last bucket also all the longer ones (more than 4 seconds).
+ */
+#define MINI_MODBUS_STATS_BUCKETS 24
+
+/**
+ * Statistics of a context, available when the library is built with MINI_MODBUS_STATS defined (it changes the layout
+ * of the context, so it must be defined for all the code using the library). Counters wrap around.
+ * Blocking transactions update all the histograms, non-blocking ones only the transaction one (from the encoding of
+ * the request to the decoding of the response), pipelined ones none. Only transactions that got a response, even an
+ * exception, are counted in the histograms.
+ */
+typedef struct MiniModbusStats {
+    /**
+     * requests sent and successful transactions, by function code
+     */
+    uint32_t requests[32];
+    uint32_t responses[32];
+
+    /**
+     * failed transactions: errors[-error] for library errors (unknown codes are counted in errors[0]), exceptions[code]
+     * for exceptions from the slave (codes greater than 15 are counted in exceptions[0])
+     */
+    uint32_t errors[MINI_MODBUS_ERROR_COUNT];
+    uint32_t exceptions[16];
+
+    /**
+     * requests sent again after a timeout or a corrupted response
+     */
+    uint32_t retries;
+
+    /**
+     * bytes of the frames sent and received
+     */
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+
+    /**
+     * latency histograms: time spent in the send callback, waiting for the response, validating and decoding it,
+     * and for the whole transaction
+     */
+    uint32_t send_time[MINI_MODBUS_STATS_BUCKETS];
+    uint32_t wait_time[MINI_MODBUS_STATS_BUCKETS];
+    uint32_t decode_time[MINI_MODBUS_STATS_BUCKETS];
+    uint32_t transaction_time[MINI_MODBUS_STATS_BUCKETS];
+
+    /* private fields */
+    uint32_t time_start;
+    uint32_t time_sent;
+    uint32_t time_received;
+} MiniModbusStats_t;
+
+#endif /* MINI_MODBUS_STATS */
+
 /**
  * Context of the MiniModbus library. Opaque structure.
  */
 typedef struct MiniModbusContext {
     MiniModbusConfig_t config;
     size_t buffer_position;
+    MiniModbusTransaction_t *pipeline;
+    size_t pipeline_pending;
+    MiniModbusTransaction_t async;
+    size_t async_received;
     uint16_t current_tcp_transaction_identifier;
     uint8_t request_code;
     uint8_t response_length;
+    uint32_t rto_us;
+    uint32_t deadline_us;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint8_t rtt_sampled;
+    struct MiniModbusCache *cache;
+#ifdef MINI_MODBUS_STATS
+    MiniModbusStats_t stats;
+#endif /* MINI_MODBUS_STATS */
     uint8_t buffer[MINI_MODBUS_BUFFER_SIZE];
 } MiniModbusContext_t;
 
@@ -153,10 +544,86 @@ typedef struct MiniModbusContext {
  *
  * @param ctx Modbus context to initialize
  * @param config Configuration object. Can be a temporary object
- * @return MiniModbus_InvalidArgument in case one of the parameters is NULL, otherwise MiniModbus_Success
+ * @return MiniModbus_InvalidArgument in case one of the parameters is NULL or the timeouts lack the callbacks they
+ *         require, otherwise MiniModbus_Success
  */
 MiniModbusError_t MiniModbus_Init(MiniModbusContext_t *ctx, const MiniModbusConfig_t *config);
 
+#ifdef MINI_MODBUS_STATS
+
+/**
+ * Get the statistics of a context (only when the library is built with MINI_MODBUS_STATS).
+ *
+ * @param ctx Modbus context
+ * @return pointer to the statistics, valid as long as the context
+ */
+const MiniModbusStats_t *MiniModbus_StatsGet(const MiniModbusContext_t *ctx);
+
+/**
+ * Reset the statistics of a context.
+ *
+ * @param ctx Modbus context
+ */
+void MiniModbus_StatsReset(MiniModbusContext_t *ctx);
+
+/**
+ * Estimate a percentile of a latency histogram.
+ *
+ * @param histogram one of the histograms of MiniModbusStats_t
+ * @param percent percentile to compute, from 0 to 100
+ * @return the upper bound, in microseconds, of the bucket where the percentile falls, 0 if the histogram is empty
+ */
+uint32_t MiniModbus_StatsPercentile(const uint32_t *histogram, unsigned percent);
+
+#endif /* MINI_MODBUS_STATS */
+
+/**
+ * Change the slave address of a context, to talk with more slaves on the same transport.
+ * In RTU mode the address 0 is the broadcast address: only writes are allowed, and they complete as soon as the
+ * request is sent, since slaves never answer to a broadcast.
+ *
+ * @param ctx Modbus context
+ * @param slave_address new slave address
+ * @return MiniModbus_InvalidArgument if the context is NULL, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_SetSlaveAddress(MiniModbusContext_t *ctx, uint8_t slave_address);
+
+/**
+ * Change the timeout and the retries of a context, for example before a request that takes the slave longer than
+ * usual. The adaptive timeout, if enabled, starts again from timeout_us. See MiniModbusConfig_t for the meaning of the
+ * parameters.
+ *
+ * @param ctx Modbus context
+ * @param timeout_us maximum time to wait a response in microseconds, 0 to wait as long as the receive callback does
+ * @param retries number of times a request is sent again after a timeout or a corrupted response
+ * @return MiniModbus_InvalidArgument if the context is NULL, a timeout is set without the receive_timeout callback or
+ *         it's shorter than timeout_min_us, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_SetTimeout(MiniModbusContext_t *ctx, uint32_t timeout_us, uint8_t retries);
+
+/**
+ * Compute the Modbus CRC16 of a buffer, with the fastest implementation available.
+ * When MINI_MODBUS_FAST_CRC is defined the carry-less multiplication is selected at runtime if the CPU supports it,
+ * otherwise the slicing-by-8 is used.
+ *
+ * @param data pointer to the data
+ * @param length number of bytes
+ * @return the CRC16 (to be sent in little endian order)
+ */
+uint16_t MiniModbus_Crc16(const void *data, size_t length);
+
+/**
+ * Compute the Modbus CRC16 of a buffer with a specific implementation, mainly useful for testing and benchmarking.
+ *
+ * @param implementation the implementation to use
+ * @param data pointer to the data
+ * @param length number of bytes
+ * @param crc pointer where to store the CRC16
+ * @return MiniModbusError_InvalidArgument if the implementation is not available, otherwise MiniModbusError_Success
+ */
+MiniModbusError_t MiniModbus_Crc16Implementation(MiniModbusCrc_t implementation, const void *data, size_t length,
+                                                 uint16_t *crc);
+
 /**
  * Read an holding register (function code 0x03) from the device.
  *
@@ -167,6 +634,32 @@ MiniModbusError_t MiniModbus_Init(MiniModbusContext_t *ctx, const MiniModbusConf
  */
 MiniModbusError_t MiniModbus_ReadHoldingRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t *value);
 
+/**
+ * Read a block of contiguous holding registers (function code 0x03) from the device with a single request.
+ *
+ * @param ctx Modbus context
+ * @param reg first register to read (zero based)
+ * @param quantity number of registers to read (1 to MINI_MODBUS_MAX_READ_REGISTERS)
+ * @param values pointer to an array of at least quantity elements where to store read data
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the response would not fit the
+ *         context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_ReadHoldingRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                  uint16_t *values);
+
+/**
+ * Read a block of contiguous input registers (function code 0x04) from the device with a single request.
+ *
+ * @param ctx Modbus context
+ * @param reg first register to read (zero based)
+ * @param quantity number of registers to read (1 to MINI_MODBUS_MAX_READ_REGISTERS)
+ * @param values pointer to an array of at least quantity elements where to store read data
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the response would not fit the
+ *         context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_ReadInputRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                uint16_t *values);
+
 /**
  * Write an holding register (function code 0x06) on the device.
  *
@@ -177,6 +670,609 @@ MiniModbusError_t MiniModbus_ReadHoldingRegister(MiniModbusContext_t *ctx, uint1
  */
 MiniModbusError_t MiniModbus_WriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value);
 
+/**
+ * Write a block of contiguous holding registers (function code 0x10) on the device with a single request.
+ *
+ * @param ctx Modbus context
+ * @param reg first register to write (zero based)
+ * @param quantity number of registers to write (1 to MINI_MODBUS_MAX_WRITE_REGISTERS)
+ * @param values pointer to an array of quantity elements to write
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the request would not fit the
+ *         context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_WriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                   const uint16_t *values);
+
+/**
+ * Write a block of holding registers and then read a block of holding registers (function code 0x17) in a single
+ * transaction. The device performs the write before the read.
+ *
+ * @param ctx Modbus context
+ * @param read_reg first register to read (zero based)
+ * @param read_quantity number of registers to read (1 to MINI_MODBUS_MAX_READ_REGISTERS)
+ * @param read_values pointer to an array of at least read_quantity elements where to store read data
+ * @param write_reg first register to write (zero based)
+ * @param write_quantity number of registers to write (1 to MINI_MODBUS_MAX_READ_WRITE_REGISTERS)
+ * @param write_values pointer to an array of write_quantity elements to write
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the request or the response would
+ *         not fit the context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_ReadWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t read_reg,
+                                                        uint16_t read_quantity, uint16_t *read_values,
+                                                        uint16_t write_reg, uint16_t write_quantity,
+                                                        const uint16_t *write_values);
+
+/**
+ * Read coils (function code 0x01) or discrete inputs (function code 0x02).
+ *
+ * @param ctx Modbus context
+ * @param reg first coil or input to read (zero based)
+ * @param quantity number of coils or inputs to read (1 to MINI_MODBUS_MAX_READ_BITS)
+ * @param values pointer to an array of at least quantity elements where to store the states, 0 or 1
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the response would not fit the
+ *         context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_ReadCoils(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity, uint8_t *values);
+MiniModbusError_t MiniModbus_ReadDiscreteInputs(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                uint8_t *values);
+
+/**
+ * Write a single coil (function code 0x05).
+ *
+ * @param ctx Modbus context
+ * @param reg coil to write (zero based)
+ * @param value state to write, ON if not 0
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_WriteSingleCoil(MiniModbusContext_t *ctx, uint16_t reg, int value);
+
+/**
+ * Write a block of coils (function code 0x0F).
+ *
+ * @param ctx Modbus context
+ * @param reg first coil to write (zero based)
+ * @param quantity number of coils to write (1 to MINI_MODBUS_MAX_WRITE_BITS)
+ * @param values pointer to an array of quantity states, ON if not 0
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the request would not fit the
+ *         context buffer, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_WriteMultipleCoils(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                const uint8_t *values);
+
+/**
+ * Unpack bits, packed as in Modbus frames and server tables (LSB first), to one byte per bit, 0 or 1.
+ *
+ * @param packed the packed bits, (count + 7) / 8 bytes
+ * @param count number of bits
+ * @param values where to store the count unpacked bits
+ */
+void MiniModbus_BitsUnpack(const uint8_t *packed, size_t count, uint8_t *values);
+
+/**
+ * Pack bits, one byte per bit (ON if not 0), as in Modbus frames and server tables (LSB first). The unused bits of the
+ * last byte are cleared.
+ *
+ * @param values the count bits to pack
+ * @param count number of bits
+ * @param packed where to store the packed bits, (count + 7) / 8 bytes
+ */
+void MiniModbus_BitsPack(const uint8_t *values, size_t count, uint8_t *packed);
+
+/**
+ * Decode 32 bit values (uint32_t, int32_t or float) stored in pairs of registers. Uses SSE2 or NEON when available.
+ * The registers and the values can be the same array, to decode in place.
+ *
+ * @param registers the registers, 2 * count elements
+ * @param count number of values
+ * @param order order of the bytes of the values in the registers
+ * @param values array of count uint32_t, int32_t or float where to store the values
+ */
+void MiniModbus_Decode32(const uint16_t *registers, size_t count, MiniModbusWordOrder_t order, void *values);
+
+/**
+ * Decode 64 bit values (uint64_t, int64_t or double) stored in groups of 4 registers, as MiniModbus_Decode32().
+ */
+void MiniModbus_Decode64(const uint16_t *registers, size_t count, MiniModbusWordOrder_t order, void *values);
+
+/**
+ * Encode 32 bit values (uint32_t, int32_t or float) into pairs of registers, to write them.
+ * The values and the registers can be the same array, to encode in place.
+ *
+ * @param values array of count uint32_t, int32_t or float to encode
+ * @param count number of values
+ * @param order order of the bytes of the values in the registers
+ * @param registers where to store the registers, 2 * count elements
+ */
+void MiniModbus_Encode32(const void *values, size_t count, MiniModbusWordOrder_t order, uint16_t *registers);
+
+/**
+ * Encode 64 bit values (uint64_t, int64_t or double) into groups of 4 registers, as MiniModbus_Encode32().
+ */
+void MiniModbus_Encode64(const void *values, size_t count, MiniModbusWordOrder_t order, uint16_t *registers);
+
+/**
+ * Read 32 or 64 bit values from consecutive holding or input registers with a single block read, and decode them.
+ *
+ * @param ctx Modbus context
+ * @param reg first register to read (zero based)
+ * @param count number of values to read, each 2 (32 bit) or 4 (64 bit) registers
+ * @param order order of the bytes of the values in the registers
+ * @param values array of count values (uint32_t, int32_t or float for 32 bit, uint64_t, int64_t or double for 64 bit)
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the registers are more than
+ *         MINI_MODBUS_MAX_READ_REGISTERS or the response would not fit the context buffer, otherwise appropriate
+ *         error code
+ */
+MiniModbusError_t MiniModbus_ReadHoldingRegisters32(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                    MiniModbusWordOrder_t order, void *values);
+MiniModbusError_t MiniModbus_ReadHoldingRegisters64(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                    MiniModbusWordOrder_t order, void *values);
+MiniModbusError_t MiniModbus_ReadInputRegisters32(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                  MiniModbusWordOrder_t order, void *values);
+MiniModbusError_t MiniModbus_ReadInputRegisters64(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                  MiniModbusWordOrder_t order, void *values);
+
+/**
+ * A pre-encoded request, for requests that are repeated many times (e.g. in a polling loop): the request is encoded
+ * once, RTU CRC included, and each execution only needs to patch the TCP transaction identifier.
+ * The object is owned by the caller. It's never modified by MiniModbus_FrameExecute(), so it can be shared between
+ * contexts with the same mode and slave address.
+ */
+typedef struct MiniModbusFrame {
+    /* private fields */
+    MiniModbusMode_t mode;
+    uint8_t function_code;
+    uint8_t response_length;
+    uint16_t address;
+    uint16_t quantity;
+    size_t length;
+    uint8_t data[MINI_MODBUS_BUFFER_SIZE];
+} MiniModbusFrame_t;
+
+/**
+ * Pre-encode a request into a frame, with the same arguments of the corresponding blocking function. For writes the
+ * values are encoded in the frame: to write different values, encode the frame again.
+ * The context buffer is used for the encoding, so no transaction can be in progress on the context.
+ *
+ * @param ctx Modbus context the frame will be executed on
+ * @param frame frame to encode
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if the arguments are invalid or the
+ *         request would not fit the context buffer
+ */
+MiniModbusError_t MiniModbus_FrameReadHoldingRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame,
+                                                       uint16_t reg, uint16_t quantity);
+MiniModbusError_t MiniModbus_FrameReadInputRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame, uint16_t reg,
+                                                     uint16_t quantity);
+MiniModbusError_t MiniModbus_FrameWriteSingleRegister(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame, uint16_t reg,
+                                                      uint16_t value);
+MiniModbusError_t MiniModbus_FrameWriteMultipleRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame,
+                                                         uint16_t reg, uint16_t quantity, const uint16_t *values);
+
+/**
+ * Execute a pre-encoded request and wait for the response, as the corresponding blocking function.
+ * RTU frames are sent as they are. TCP frames are sent with the sendv callback, with the MBAP header (with the
+ * transaction identifier of this execution) and the rest of the frame as two buffers, or otherwise copied in the
+ * context buffer and sent with the send callback.
+ *
+ * @param ctx Modbus context
+ * @param frame the pre-encoded request
+ * @param values for reads, pointer to an array where to store the read registers. Ignored for writes
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_FrameExecute(MiniModbusContext_t *ctx, const MiniModbusFrame_t *frame, uint16_t *values);
+
+/**
+ * Build a poll plan: compute the smallest set of contiguous block reads that fetches all the points, within the
+ * limits of the device. The points array is sorted by address in place, and must stay valid with the blocks array
+ * as long as the plan is used. The same address can appear in more points.
+ *
+ * @param ctx Modbus context the plan will be executed on (the maximum block length depends on its mode)
+ * @param plan plan to build
+ * @param table table to read, MiniModbusTable_HoldingRegisters or MiniModbusTable_InputRegisters
+ * @param points registers to read and where to store them
+ * @param point_count number of points
+ * @param limits device limits, can be NULL for the default ones
+ * @param blocks array where to store the blocks of the plan
+ * @param max_blocks number of elements of blocks (point_count is always enough)
+ * @return MiniModbus_Success in case of success, MiniModbusError_InvalidArgument if a point is in a hole or the
+ *         plan needs more than max_blocks blocks
+ */
+MiniModbusError_t MiniModbus_PollPlanBuild(MiniModbusContext_t *ctx, MiniModbusPollPlan_t *plan,
+                                           MiniModbusTable_t table, MiniModbusPollPoint_t *points, size_t point_count,
+                                           const MiniModbusPollLimits_t *limits, MiniModbusPollBlock_t *blocks,
+                                           size_t max_blocks);
+
+/**
+ * Execute a poll plan: perform all the block reads and scatter the values to the points. A failed block doesn't
+ * stop the others: the result of each block is stored in it.
+ *
+ * @param ctx Modbus context
+ * @param plan plan to execute
+ * @return MiniModbus_Success if all the blocks were read, otherwise the error of the first failed block
+ */
+MiniModbusError_t MiniModbus_PollPlanExecute(MiniModbusContext_t *ctx, MiniModbusPollPlan_t *plan);
+
+/**
+ * A cached register.
+ */
+typedef struct MiniModbusCacheEntry {
+    uint32_t time;
+    uint16_t value;
+    uint16_t valid;
+} MiniModbusCacheEntry_t;
+
+/**
+ * A range of registers that can be served from the cache for ttl_ms milliseconds after being read from the device.
+ */
+typedef struct MiniModbusCacheRange {
+    MiniModbusTable_t table;
+    uint16_t start;
+    uint16_t count;
+    uint32_t ttl_ms;
+
+    /**
+     * caller owned array of count entries
+     */
+    MiniModbusCacheEntry_t *entries;
+} MiniModbusCacheRange_t;
+
+/**
+ * A register cache in front of the read functions of a context, to share the values read from a slow device between
+ * many readers. Only registers in the ranges of the cache are cached. Nothing is allocated: the ranges and their
+ * entries are owned by the caller.
+ */
+typedef struct MiniModbusCache {
+    MiniModbusContext_t *ctx;
+    MiniModbusCacheRange_t *ranges;
+    size_t range_count;
+
+    /**
+     * monotonic clock in milliseconds, it may wrap around
+     *
+     * @param user_data clock_user_data
+     * @return the current time in milliseconds
+     */
+    uint32_t (*clock)(void *user_data);
+    void *clock_user_data;
+
+    /**
+     * statistics: reads served from the cache, and reads that needed a transaction
+     */
+    unsigned long hits;
+    unsigned long misses;
+} MiniModbusCache_t;
+
+/**
+ * Initialize a register cache, with all the entries invalid, and attach it to the context: from then on every write
+ * of holding registers sent with the context, blocking, pipelined, non-blocking or from a pre-encoded frame,
+ * invalidates them in the cache.
+ * Only one cache at a time is attached to a context, the last one initialized. The cache must stay valid as long as
+ * it is attached: call MiniModbus_CacheDetach() before it goes out of scope or is initialized on another context.
+ *
+ * @param cache cache to initialize
+ * @param ctx Modbus context used for the reads on a cache miss, and for the writes
+ * @param ranges ranges of registers to cache, must stay valid as long as the cache is used
+ * @param range_count number of ranges
+ * @param clock monotonic clock in milliseconds
+ * @param clock_user_data pointer passed to the clock
+ * @return MiniModbus_InvalidArgument in case one of the parameters is invalid, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_CacheInit(MiniModbusCache_t *cache, MiniModbusContext_t *ctx,
+                                       MiniModbusCacheRange_t *ranges, size_t range_count,
+                                       uint32_t (*clock)(void *user_data), void *clock_user_data);
+
+/**
+ * Detach the cache from its context, if still attached: the writes made with the context no longer invalidate it.
+ * The cache can still be used, with the wrapper functions.
+ *
+ * @param cache the cache
+ */
+void MiniModbus_CacheDetach(MiniModbusCache_t *cache);
+
+/**
+ * Read registers as the corresponding functions of the context, from the cache if all of them are cached and not
+ * expired, otherwise with a transaction whose result refreshes the cache.
+ */
+MiniModbusError_t MiniModbus_CacheReadHoldingRegister(MiniModbusCache_t *cache, uint16_t reg, uint16_t *value);
+MiniModbusError_t MiniModbus_CacheReadHoldingRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                       uint16_t *values);
+MiniModbusError_t MiniModbus_CacheReadInputRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                     uint16_t *values);
+
+/**
+ * Write registers as the corresponding functions of the context, invalidating them in the cache, so that the next
+ * read gets them from the device (that may have rejected or adjusted the values). Writes made directly with the
+ * context invalidate the attached cache as well. Writes made by other masters leave stale values in the cache till
+ * they expire, or till MiniModbus_CacheInvalidate() is called.
+ */
+MiniModbusError_t MiniModbus_CacheWriteSingleRegister(MiniModbusCache_t *cache, uint16_t reg, uint16_t value);
+MiniModbusError_t MiniModbus_CacheWriteMultipleRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                         const uint16_t *values);
+
+/**
+ * Invalidate cached registers.
+ *
+ * @param cache the cache
+ * @param table MiniModbusTable_HoldingRegisters or MiniModbusTable_InputRegisters
+ * @param reg first register to invalidate
+ * @param quantity number of registers to invalidate
+ */
+void MiniModbus_CacheInvalidate(MiniModbusCache_t *cache, MiniModbusTable_t table, uint16_t reg, uint16_t quantity);
+
+/**
+ * Pipelined TCP mode.
+ *
+ * The following functions send a request without waiting for its response, so that many requests can be in flight
+ * on the same connection. Responses are matched to their transaction by the MBAP transaction identifier, so servers
+ * are free to answer out of order. Call MiniModbus_PipelinePoll() to receive responses, and don't mix pipelined and
+ * blocking calls on the same context while transactions are pending. Only available in TCP mode.
+ *
+ * @param ctx Modbus context
+ * @param transaction caller owned transaction object, not already pending
+ * @return MiniModbus_Success if the request was sent, otherwise appropriate error code (in that case the
+ *         transaction is not pending and its callback will not be called)
+ */
+MiniModbusError_t MiniModbus_PipelineReadHoldingRegisters(MiniModbusContext_t *ctx,
+                                                          MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                          uint16_t quantity, uint16_t *values);
+MiniModbusError_t MiniModbus_PipelineReadInputRegisters(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                                        uint16_t reg, uint16_t quantity, uint16_t *values);
+MiniModbusError_t MiniModbus_PipelineWriteSingleRegister(MiniModbusContext_t *ctx,
+                                                         MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                         uint16_t value);
+MiniModbusError_t MiniModbus_PipelineWriteMultipleRegisters(MiniModbusContext_t *ctx,
+                                                            MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                            uint16_t quantity, const uint16_t *values);
+
+/**
+ * Receive one response and complete the matching pending transaction, calling its callback.
+ *
+ * If a timeout is set and no complete response arrives within it, if the receive fails or if the MBAP header has an
+ * invalid length, the connection is out of sync: the received data is flushed and all the pending transactions are
+ * completed with the error returned (MiniModbusError_Timeout, MiniModbusError_Receive or
+ * MiniModbusError_ResponseInvalidLength).
+ *
+ * @param ctx Modbus context
+ * @return MiniModbus_Success if a transaction was completed (its own result is in the transaction object),
+ *         MiniModbusError_ResponseInvalidTransactionIdentifier if the response didn't match any pending transaction
+ *         and was discarded, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_PipelinePoll(MiniModbusContext_t *ctx);
+
+/**
+ * Receive responses till all the pending transactions are completed. In case of a receive error or a timeout all the
+ * pending transactions are aborted with that error.
+ *
+ * @param ctx Modbus context
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_PipelineFlush(MiniModbusContext_t *ctx);
+
+/**
+ * Complete all the pending transactions with the specified error, for example after the connection was lost.
+ * Transactions submitted by the callbacks meanwhile stay pending.
+ *
+ * @param ctx Modbus context
+ * @param error result to set in the aborted transactions
+ */
+void MiniModbus_PipelineAbort(MiniModbusContext_t *ctx, MiniModbusError_t error);
+
+/**
+ * Non-blocking mode.
+ *
+ * The following functions encode a request into the context buffer and hand back the frame to send, without calling
+ * the send or receive callbacks: the caller is responsible to send the frame, then pass the received bytes, in chunks
+ * of any size, to MiniModbus_AsyncFeed() till it returns something different than MiniModbusError_Pending.
+ * This allows to drive many connections from a single event loop thread. The frame pointer is valid till the next
+ * call on the context: the whole frame must be sent before feeding the first byte of the response.
+ * Only one request at a time can be in progress on a context.
+ *
+ * @param ctx Modbus context
+ * @param frame pointer where to store a pointer to the encoded request frame
+ * @param frame_length pointer where to store the length of the encoded request frame
+ * @return MiniModbus_Success if the request was encoded, MiniModbusError_InvalidArgument if another request is still
+ *         in progress (see MiniModbus_AsyncCancel()), otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_AsyncReadHoldingRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                       uint16_t *values, const uint8_t **frame, size_t *frame_length);
+MiniModbusError_t MiniModbus_AsyncReadInputRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                     uint16_t *values, const uint8_t **frame, size_t *frame_length);
+MiniModbusError_t MiniModbus_AsyncWriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value,
+                                                      const uint8_t **frame, size_t *frame_length);
+MiniModbusError_t MiniModbus_AsyncWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                         const uint16_t *values, const uint8_t **frame,
+                                                         size_t *frame_length);
+MiniModbusError_t MiniModbus_AsyncReadWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t read_reg,
+                                                             uint16_t read_quantity, uint16_t *read_values,
+                                                             uint16_t write_reg, uint16_t write_quantity,
+                                                             const uint16_t *write_values, const uint8_t **frame,
+                                                             size_t *frame_length);
+
+/**
+ * Feed received bytes to the request in progress. Bytes after the end of the response frame are not consumed.
+ *
+ * @param ctx Modbus context
+ * @param data pointer to the received bytes
+ * @param length number of received bytes
+ * @param consumed pointer where to store the number of bytes used, can be NULL
+ * @return MiniModbusError_Pending if more bytes are needed, MiniModbus_Success if the response was received and
+ *         decoded, otherwise appropriate error code. In both latter cases the request is no longer in progress.
+ */
+MiniModbusError_t MiniModbus_AsyncFeed(MiniModbusContext_t *ctx, const uint8_t *data, size_t length, size_t *consumed);
+
+/**
+ * Abandon the request in progress, for example because no response arrived in time.
+ *
+ * @param ctx Modbus context
+ */
+void MiniModbus_AsyncCancel(MiniModbusContext_t *ctx);
+
+/**
+ * A contiguous block of registers served by a server, owned by the caller.
+ */
+typedef struct MiniModbusRegisters {
+    /**
+     * register values, values[0] is the register at address start
+     */
+    uint16_t *values;
+
+    /**
+     * address of the first register (zero based)
+     */
+    uint16_t start;
+
+    /**
+     * number of registers, 0 if the table is not served
+     */
+    size_t count;
+} MiniModbusRegisters_t;
+
+/**
+ * A contiguous block of coils or discrete inputs served by a server, owned by the caller.
+ */
+typedef struct MiniModbusBits {
+    /**
+     * packed bit values, the least significant bit of bits[0] is the bit at address start
+     */
+    uint8_t *bits;
+
+    /**
+     * address of the first bit (zero based)
+     */
+    uint16_t start;
+
+    /**
+     * number of bits, 0 if the table is not served
+     */
+    size_t count;
+} MiniModbusBits_t;
+
+/**
+ * MiniModbus server (slave). Requests are served directly from the flat tables provided by the caller: reads and
+ * writes are range checked against the tables, and requests outside them get an illegal data address exception.
+ * Function codes 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0F, 0x10 and 0x17 are supported.
+ */
+typedef struct MiniModbusServer {
+    /**
+     * mode, address and transport of the server. The transport callbacks are only needed by MiniModbus_ServerPoll()
+     */
+    MiniModbusConfig_t config;
+
+    MiniModbusBits_t coils;
+    MiniModbusBits_t discrete_inputs;
+    MiniModbusRegisters_t input_registers;
+    MiniModbusRegisters_t holding_registers;
+
+    /**
+     * function called after coils or holding registers are written by a request. Can be NULL.
+     *
+     * @param server the server
+     * @param table the table that was written
+     * @param address first written address
+     * @param quantity number of written coils or registers
+     */
+    void (*on_write)(struct MiniModbusServer *server, MiniModbusTable_t table, uint16_t address, uint16_t quantity);
+
+    /* private fields, buffers used by MiniModbus_ServerPoll() */
+    uint8_t buffer[MINI_MODBUS_MAX_FRAME_SIZE];
+    uint8_t response[MINI_MODBUS_MAX_FRAME_SIZE];
+} MiniModbusServer_t;
+
+/**
+ * Initialize a server with the specified config. All the tables are empty: set them after this call.
+ *
+ * @param server server to initialize
+ * @param config configuration object. Can be a temporary object. The transport callbacks can be NULL
+ * @return MiniModbus_InvalidArgument in case one of the parameters is invalid, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_ServerInit(MiniModbusServer_t *server, const MiniModbusConfig_t *config);
+
+/**
+ * Process a complete request frame and build the response frame, without using the transport callbacks.
+ * Doesn't use the server buffers, so it can be called concurrently for different connections as long as the
+ * tables are not modified meanwhile.
+ *
+ * @param server the server
+ * @param request the request frame
+ * @param request_length length of the request frame
+ * @param response buffer of at least MINI_MODBUS_MAX_FRAME_SIZE bytes where to store the response frame
+ * @param response_length pointer where to store the length of the response, 0 if nothing has to be sent back
+ *                        (RTU broadcast or frame for another slave)
+ * @return MiniModbus_Success if the request was processed (errors in the request are reported to the client with an
+ *         exception response), otherwise an error code if the frame is invalid and has to be discarded
+ */
+MiniModbusError_t MiniModbus_ServerHandleFrame(MiniModbusServer_t *server, const uint8_t *request,
+                                               size_t request_length, uint8_t *response, size_t *response_length);
+
+/**
+ * Receive a request with the receive callback, process it and send back the response with the send callback.
+ * An RTU request with an unknown function code can't be delimited: it is discarded with the flush callback if set,
+ * otherwise by reading till the line is silent for timeout_us (requires receive_timeout), and no response is sent.
+ *
+ * @param server the server
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_ServerPoll(MiniModbusServer_t *server);
+
+/**
+ * Length of a Modbus frame, given its first bytes. Useful to split a byte stream into frames: call it with the bytes
+ * received so far, and receive more till the returned length is available.
+ *
+ * @param mode framing of the stream
+ * @param request 1 if the frame is a request (sent to a slave), 0 if it's a response
+ * @param frame the bytes of the frame received so far
+ * @param available number of bytes in frame
+ * @return the total length of the frame once it can be determined, otherwise the number of bytes needed to determine
+ *         it (always greater than available), or 0 if the frame has an unknown function code (RTU mode only)
+ */
+size_t MiniModbus_FrameLength(MiniModbusMode_t mode, int request, const uint8_t *frame, size_t available);
+
+/**
+ * A buffered receive layer between the library and a stream transport. The library receives a frame with more calls
+ * of known length (header, then the rest of the frame): this layer instead reads whatever the transport has
+ * available into its buffer, so that a frame usually takes a single system call, and keeps any surplus byte for the
+ * next frame. The object is owned by the caller and must stay valid as long as the config is used.
+ */
+typedef struct MiniModbusBufferedTransport {
+    /* private fields */
+    void *user_data;
+    int (*read)(void *user_data, void *data, size_t length);
+    int (*read_timeout)(void *user_data, void *data, size_t length, uint32_t timeout_us);
+    int (*send)(void *user_data, const void *data, size_t length);
+    int (*sendv)(void *user_data, const MiniModbusIoVec_t *iov, size_t iov_count);
+    void (*flush)(void *user_data);
+    uint32_t (*clock)(void *user_data);
+#ifdef MINI_MODBUS_STATS
+    void (*trace_send)(void *user_data, const uint8_t *frame, size_t length);
+    void (*trace_receive)(void *user_data, const uint8_t *frame, size_t length, MiniModbusError_t result);
+#endif /* MINI_MODBUS_STATS */
+    size_t start;
+    size_t end;
+    uint8_t buffer[MINI_MODBUS_RECEIVE_BUFFER_SIZE];
+} MiniModbusBufferedTransport_t;
+
+/**
+ * Insert a buffered transport into a config, before passing it to MiniModbus_Init() or MiniModbus_ServerInit().
+ * The receive callback of the config changes meaning: it has to work as read(2), blocking till at least 1 byte is
+ * available, then returning as many bytes as available (up to length). So does receive_timeout, if set, returning 0
+ * when nothing arrives within the timeout. The user_data and the callbacks of the config are replaced with the ones
+ * of the buffered transport, and called by it. The config always gets a flush callback, that also discards the
+ * buffered bytes.
+ *
+ * @param transport buffered transport to initialize
+ * @param config config with the read-like receive callback, modified in place
+ * @return MiniModbus_InvalidArgument in case one of the parameters is invalid, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_BufferedTransportInit(MiniModbusBufferedTransport_t *transport,
+                                                   MiniModbusConfig_t *config);
+
+/**
+ * Discard the buffered bytes, for example after a timeout or a protocol error, when they can only belong to a late or
+ * garbled frame.
+ *
+ * @param transport the buffered transport
+ */
+void MiniModbus_BufferedTransportFlush(MiniModbusBufferedTransport_t *transport);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,268 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus.hpp
+ * @brief optional C++17 layer: register maps declared as types, with block requests encoded at compile time
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_HPP
+#define MINI_MODBUS_HPP
+
+#include "minimodbus.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace minimodbus {
+
+namespace detail {
+
+// function codes and framing, as in minimodbus.c
+constexpr uint8_t FUNCTION_READ_HOLDING_REGISTER = 0x03;
+constexpr uint8_t FUNCTION_READ_INPUT_REGISTER = 0x04;
+constexpr size_t MODBUS_RTU_FRAME_OVERHEAD = 3;
+constexpr size_t MODBUS_TCP_FRAME_OVERHEAD = 7;
+
+/*
+ * Bit at a time CRC16 of RTU frames: slow, but only meant to run at compile time.
+ */
+constexpr uint16_t Crc16(const uint8_t *data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) != 0 ? static_cast<uint16_t>((crc >> 1) ^ 0xA001) : static_cast<uint16_t>(crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+template <MiniModbusMode_t Mode, uint8_t SlaveAddress, uint8_t FunctionCode, uint16_t Address, uint16_t Quantity>
+constexpr MiniModbusFrame_t EncodeRead()
+{
+    static_assert(Mode == MiniModbusMode_RTU || Mode == MiniModbusMode_TCP, "unknown mode");
+    static_assert((Mode == MiniModbusMode_TCP ? MODBUS_TCP_FRAME_OVERHEAD : MODBUS_RTU_FRAME_OVERHEAD) + 2 +
+                          Quantity * 2 <=
+                      MINI_MODBUS_BUFFER_SIZE,
+                  "the response doesn't fit the context buffer");
+
+    MiniModbusFrame_t frame{};
+    size_t length = 0;
+
+    if constexpr (Mode == MiniModbusMode_TCP) {
+        // transaction identifier (patched at each execution) and protocol identifier are 0, then the length of the
+        // rest of the frame
+        frame.data[5] = 6;
+        length = 6;
+    }
+    frame.data[length++] = SlaveAddress;
+    frame.data[length++] = FunctionCode;
+    frame.data[length++] = static_cast<uint8_t>(Address >> 8);
+    frame.data[length++] = static_cast<uint8_t>(Address & 0xFF);
+    frame.data[length++] = static_cast<uint8_t>(Quantity >> 8);
+    frame.data[length++] = static_cast<uint8_t>(Quantity & 0xFF);
+    if constexpr (Mode == MiniModbusMode_RTU) {
+        uint16_t crc = Crc16(frame.data, length);
+        frame.data[length++] = static_cast<uint8_t>(crc & 0xFF);
+        frame.data[length++] = static_cast<uint8_t>(crc >> 8);
+    }
+
+    frame.mode = Mode;
+    frame.function_code = FunctionCode;
+    frame.response_length = static_cast<uint8_t>(1 + Quantity * 2);
+    frame.address = Address;
+    frame.quantity = Quantity;
+    frame.length = length;
+
+    return frame;
+}
+
+template <size_t Width>
+using Bits = std::conditional_t<Width == 1, uint16_t, std::conditional_t<Width == 2, uint32_t, uint64_t>>;
+
+template <typename Field>
+typename Field::Type Decode(const uint16_t *registers)
+{
+    constexpr size_t width = Field::width;
+    constexpr bool swap_words = (Field::order & 1) != 0;
+    constexpr bool swap_bytes = (Field::order & 2) != 0 && width > 1;
+
+    uint64_t bits = 0;
+    for (size_t i = 0; i < width; i++) {
+        uint16_t word = registers[swap_words ? width - 1 - i : i];
+        if (swap_bytes) {
+            word = static_cast<uint16_t>((word << 8) | (word >> 8));
+        }
+        bits = (bits << 16) | word;
+    }
+
+    Bits<width> raw = static_cast<Bits<width>>(bits);
+    typename Field::Type value;
+    std::memcpy(&value, &raw, sizeof(value));
+
+    return value;
+}
+
+template <typename Field>
+void Encode(typename Field::Type value, uint16_t *registers)
+{
+    constexpr size_t width = Field::width;
+    constexpr bool swap_words = (Field::order & 1) != 0;
+    constexpr bool swap_bytes = (Field::order & 2) != 0 && width > 1;
+
+    Bits<width> raw;
+    std::memcpy(&raw, &value, sizeof(raw));
+    uint64_t bits = raw;
+
+    for (size_t i = 0; i < width; i++) {
+        uint16_t word = static_cast<uint16_t>(bits >> (16 * (width - 1 - i)));
+        if (swap_bytes) {
+            word = static_cast<uint16_t>((word << 8) | (word >> 8));
+        }
+        registers[swap_words ? width - 1 - i : i] = word;
+    }
+}
+
+} // namespace detail
+
+/**
+ * A field of a register map: a 16, 32 or 64 bit integer or floating point value stored from register Address, in
+ * 1, 2 or 4 registers with the given word order (ignored for 16 bit values).
+ */
+template <uint16_t Address, typename T, MiniModbusWordOrder_t Order = MiniModbusWordOrder_ABCD>
+struct Register {
+    static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "a register holds a number");
+    static_assert(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "values take 1, 2 or 4 registers");
+
+    using Type = T;
+    static constexpr uint16_t address = Address;
+    static constexpr uint16_t width = sizeof(T) / 2;
+    static constexpr MiniModbusWordOrder_t order = Order;
+};
+
+/**
+ * Fields of a register map read with a single request, from the first register of the fields to the last one. The
+ * request is encoded at compile time, RTU CRC included, for each mode and slave address it's used with.
+ */
+template <MiniModbusTable_t Table, typename... Registers>
+struct Block {
+    static_assert(sizeof...(Registers) > 0, "a block needs at least a register");
+    static_assert(Table == MiniModbusTable_HoldingRegisters || Table == MiniModbusTable_InputRegisters,
+                  "blocks read holding or input registers");
+
+    static constexpr uint16_t start = std::min({Registers::address...});
+    static constexpr uint16_t quantity =
+        static_cast<uint16_t>(std::max({static_cast<uint32_t>(Registers::address + Registers::width)...}) - start);
+    static_assert(static_cast<uint32_t>(start) + quantity <= 0x10000, "the block goes past the last register");
+    static_assert(quantity <= MINI_MODBUS_MAX_READ_REGISTERS, "the block is too long for a single request");
+
+    /**
+     * the request, ready for MiniModbus_FrameExecute()
+     */
+    template <MiniModbusMode_t Mode, uint8_t SlaveAddress>
+    static constexpr MiniModbusFrame_t frame =
+        detail::EncodeRead<Mode, SlaveAddress,
+                           Table == MiniModbusTable_HoldingRegisters ? detail::FUNCTION_READ_HOLDING_REGISTER
+                                                                     : detail::FUNCTION_READ_INPUT_REGISTER,
+                           start, quantity>();
+
+    /**
+     * The registers read by the block. Fields are decoded from their known offset when accessed.
+     */
+    struct Values {
+        uint16_t registers[quantity];
+
+        template <typename Field>
+        typename Field::Type Get() const
+        {
+            static_assert(Field::address >= start && Field::address + Field::width <= start + quantity,
+                          "the field is not part of the block");
+
+            return detail::Decode<Field>(registers + (Field::address - start));
+        }
+    };
+};
+
+/**
+ * A slave, with its mode and address fixed at compile time, reached through a context. Requests set the slave
+ * address of the context, so slaves can share it.
+ */
+template <MiniModbusMode_t Mode, uint8_t SlaveAddress>
+class Device {
+public:
+    explicit Device(MiniModbusContext_t *ctx) noexcept
+        : ctx_(ctx)
+    {
+    }
+
+    /**
+     * Read a block with its pre-encoded request.
+     *
+     * @param values where to store the registers of the block
+     * @return MiniModbus_Success in case of success, otherwise appropriate error code
+     */
+    template <typename FieldBlock>
+    MiniModbusError_t Read(typename FieldBlock::Values &values) const noexcept
+    {
+        MiniModbus_SetSlaveAddress(ctx_, SlaveAddress);
+
+        return MiniModbus_FrameExecute(ctx_, &FieldBlock::template frame<Mode, SlaveAddress>, values.registers);
+    }
+
+    /**
+     * Write a field, as a holding register.
+     *
+     * @param value value to write
+     * @return MiniModbus_Success in case of success, otherwise appropriate error code
+     */
+    template <typename Field>
+    MiniModbusError_t Write(typename Field::Type value) const noexcept
+    {
+        uint16_t registers[Field::width];
+        detail::Encode<Field>(value, registers);
+
+        MiniModbus_SetSlaveAddress(ctx_, SlaveAddress);
+        if constexpr (Field::width == 1) {
+            return MiniModbus_WriteSingleRegister(ctx_, Field::address, registers[0]);
+        } else {
+            return MiniModbus_WriteMultipleRegisters(ctx_, Field::address, Field::width, registers);
+        }
+    }
+
+private:
+    MiniModbusContext_t *ctx_;
+};
+
+} // namespace minimodbus
+
+#endif /* MINI_MODBUS_HPP */
@@ -0,0 +1,216 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_bridge.h
+ * @brief a Linux Modbus TCP to RTU gateway, serving many TCP clients on a few serial lines
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_BRIDGE_H
+#define MINI_MODBUS_BRIDGE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <pthread.h>
+
+#include "minimodbus.h"
+
+/**
+ * Maximum number of serial lines of a bridge
+ */
+#define MINI_MODBUS_BRIDGE_MAX_LINES 32
+
+/**
+ * Size of the output buffer of a TCP client, in bytes. A client that doesn't read its responses and lets it fill up
+ * is disconnected.
+ */
+#define MINI_MODBUS_BRIDGE_OUTPUT_SIZE 2048
+
+/**
+ * Maximum size of a RTU frame (slave address, PDU, CRC)
+ */
+#define MINI_MODBUS_BRIDGE_RTU_FRAME_SIZE 256
+
+/**
+ * A request received from a TCP client. The requests are a pool owned by the caller, shared by all the lines: one
+ * is taken by each request waiting for its response.
+ */
+typedef struct MiniModbusBridgeRequest {
+    /* private fields */
+    struct MiniModbusBridgeClient *client;
+    struct MiniModbusBridgeRequest *next;
+    struct MiniModbusBridgeRequest *coalesced;
+    uint16_t transaction_id;
+    size_t length;
+    uint8_t frame[MINI_MODBUS_BRIDGE_RTU_FRAME_SIZE];
+} MiniModbusBridgeRequest_t;
+
+/**
+ * A TCP client connection. The clients are a pool owned by the caller. Opaque structure.
+ */
+typedef struct MiniModbusBridgeClient {
+    int fd;
+    size_t received;
+    size_t output_length;
+    uint8_t input[MINI_MODBUS_MAX_FRAME_SIZE];
+    uint8_t output[MINI_MODBUS_BRIDGE_OUTPUT_SIZE];
+} MiniModbusBridgeClient_t;
+
+/**
+ * A serial line, with the RTU slaves with unit identifier from first_unit to last_unit. The object is owned by the
+ * caller: set the configuration fields after MiniModbus_BridgeLineInit(), and don't touch them while the bridge is
+ * running.
+ */
+typedef struct MiniModbusBridgeLine {
+    /**
+     * file descriptor of the serial port, opened and configured (speed, parity) by the caller. The bridge makes it
+     * non-blocking.
+     */
+    int fd;
+
+    /**
+     * speed of the line, in bits per second. Used for the silent interval between frames and to account for the
+     * transmission time in the response timeout.
+     */
+    uint32_t baud_rate;
+
+    /**
+     * range of unit identifiers routed to this line. Requests to unit 0 are broadcast, on the first line
+     * that has first_unit 0.
+     */
+    uint8_t first_unit;
+    uint8_t last_unit;
+
+    /**
+     * maximum time to wait for a response, in milliseconds, after the request is transmitted. On timeout the clients
+     * get a gateway target device failed to respond exception.
+     */
+    uint32_t timeout_ms;
+
+    /**
+     * delay after a broadcast request, in milliseconds, to let the slaves process it
+     */
+    uint32_t turnaround_ms;
+
+    /**
+     * statistics
+     */
+    unsigned long requests;
+    unsigned long coalesced;
+    unsigned long timeouts;
+    unsigned long errors;
+
+    /* private fields */
+    struct MiniModbusBridge *bridge;
+    size_t index;
+    int timer_fd;
+    int state;
+    uint32_t char_us;
+    uint32_t silence_us;
+    MiniModbusBridgeRequest_t *head;
+    MiniModbusBridgeRequest_t *tail;
+    MiniModbusBridgeRequest_t *current;
+    size_t sent;
+    size_t received;
+    uint8_t buffer[MINI_MODBUS_BRIDGE_RTU_FRAME_SIZE];
+} MiniModbusBridgeLine_t;
+
+/**
+ * The bridge. Opaque structure.
+ */
+typedef struct MiniModbusBridge {
+    MiniModbusBridgeLine_t *lines[MINI_MODBUS_BRIDGE_MAX_LINES];
+    size_t line_count;
+    MiniModbusBridgeClient_t *clients;
+    size_t max_clients;
+    MiniModbusBridgeRequest_t *requests;
+    size_t max_requests;
+    MiniModbusBridgeRequest_t *free_requests;
+    pthread_t thread;
+    int listen_fd;
+    int epoll_fd;
+    int wakeup_fd;
+    int running;
+} MiniModbusBridge_t;
+
+/**
+ * Initialize a bridge.
+ *
+ * @param bridge bridge to initialize
+ * @param clients caller owned array of clients, the maximum number of concurrent TCP connections
+ * @param max_clients number of elements of clients
+ * @param requests caller owned array of requests, the maximum number of requests queued on all the lines
+ * @param max_requests number of elements of requests
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_BridgeInit(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *clients,
+                                        size_t max_clients, MiniModbusBridgeRequest_t *requests, size_t max_requests);
+
+/**
+ * Initialize a serial line with a 1 s response timeout and a 100 ms broadcast turnaround delay.
+ *
+ * @param line line to initialize
+ * @param fd file descriptor of the serial port
+ * @param baud_rate speed of the line
+ * @param first_unit first unit identifier routed to the line
+ * @param last_unit last unit identifier routed to the line
+ */
+void MiniModbus_BridgeLineInit(MiniModbusBridgeLine_t *line, int fd, uint32_t baud_rate, uint8_t first_unit,
+                               uint8_t last_unit);
+
+/**
+ * Add a serial line to the bridge. Must be called before MiniModbus_BridgeStart().
+ *
+ * @param bridge the bridge
+ * @param line the line
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_BridgeAddLine(MiniModbusBridge_t *bridge, MiniModbusBridgeLine_t *line);
+
+/**
+ * Start the thread of the bridge, that accepts TCP clients on a listening socket and forwards their requests.
+ *
+ * @param bridge the bridge
+ * @param listen_fd listening TCP socket, owned by the caller
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_BridgeStart(MiniModbusBridge_t *bridge, int listen_fd);
+
+/**
+ * Stop the thread of the bridge and close all the client connections. Requests in progress are abandoned.
+ *
+ * @param bridge the bridge
+ */
+void MiniModbus_BridgeStop(MiniModbusBridge_t *bridge);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_BRIDGE_H */
@@ -0,0 +1,158 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_bus.h
+ * @brief a scheduler that shares one RTU line (e.g. RS-485) between many slaves
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_BUS_H
+#define MINI_MODBUS_BUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "minimodbus.h"
+
+/**
+ * Number of priority classes of the jobs. Class 0 has the highest priority.
+ */
+#define MINI_MODBUS_BUS_PRIORITIES 4
+
+/**
+ * A job executed on the bus: one or more transactions with a slave, repeated every period. The object is owned by
+ * the caller and must stay valid till it's removed from the bus (or executed, for one shot jobs).
+ */
+typedef struct MiniModbusBusJob {
+    /**
+     * address of the slave. 0 is the broadcast address: only writes are possible, and no response is waited
+     */
+    uint8_t slave_address;
+
+    /**
+     * priority class, from 0 (highest, e.g. alarms) to MINI_MODBUS_BUS_PRIORITIES - 1 (lowest, e.g. trends).
+     * When more jobs are due, the one with the highest priority runs first.
+     */
+    uint8_t priority;
+
+    /**
+     * period of the job, in microseconds. 0 for a one shot job, removed from the bus once executed.
+     */
+    uint32_t period_us;
+
+    /**
+     * function that performs the transactions of the job, with the context of the bus addressed to the slave.
+     *
+     * @param ctx the context of the bus
+     * @param job the job
+     * @return result of the job, stored in result
+     */
+    MiniModbusError_t (*execute)(MiniModbusContext_t *ctx, struct MiniModbusBusJob *job);
+
+    /**
+     * a pointer to data that may be used in execute
+     */
+    void *user_data;
+
+    /**
+     * result of the last execution
+     */
+    MiniModbusError_t result;
+
+    /* private fields */
+    struct MiniModbusBusJob *next;
+    uint32_t next_time_us;
+} MiniModbusBusJob_t;
+
+/**
+ * The bus scheduler. It owns a context in RTU mode, whose transport callbacks are wrapped to keep the line silent
+ * for 3.5 characters between frames (and longer after a broadcast, to let the slaves process it), waiting only for
+ * the part of the gap that didn't already elapse. Opaque structure, apart for the configuration fields.
+ */
+typedef struct MiniModbusBus {
+    /**
+     * silence after a broadcast, in microseconds, before the next request. Default 100 ms.
+     */
+    uint32_t broadcast_delay_us;
+
+    /* private fields */
+    MiniModbusContext_t ctx;
+    MiniModbusConfig_t transport;
+    uint32_t (*clock)(void *user_data);
+    void (*delay)(void *user_data, uint32_t us);
+    MiniModbusBusJob_t *jobs;
+    uint32_t frame_gap_us;
+    uint32_t idle_since_us;
+    uint32_t silence_us;
+} MiniModbusBus_t;
+
+/**
+ * Initialize a bus.
+ *
+ * @param bus bus to initialize
+ * @param config transport of the line, in RTU mode. The slave address is ignored, the timeouts and retries apply to
+ *               the requests of all the jobs. Can be a temporary object
+ * @param baud_rate baud rate of the line, to compute the inter-frame gap (fixed to 1750 us above 19200 baud)
+ * @param clock monotonic clock in microseconds, it may wrap around, called with the user_data of the config
+ * @param delay function that waits the specified microseconds, called with the user_data of the config
+ * @return MiniModbus_InvalidArgument in case one of the parameters is invalid, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_BusInit(MiniModbusBus_t *bus, const MiniModbusConfig_t *config, uint32_t baud_rate,
+                                     uint32_t (*clock)(void *user_data), void (*delay)(void *user_data, uint32_t us));
+
+/**
+ * Add a job to the bus. It's due right away.
+ *
+ * @param bus the bus
+ * @param job the job, with its configuration fields set
+ * @return MiniModbus_InvalidArgument in case one of the parameters is invalid, otherwise MiniModbus_Success
+ */
+MiniModbusError_t MiniModbus_BusAddJob(MiniModbusBus_t *bus, MiniModbusBusJob_t *job);
+
+/**
+ * Remove a job from the bus. Can't be called from the execute function of the job.
+ *
+ * @param bus the bus
+ * @param job the job
+ */
+void MiniModbus_BusRemoveJob(MiniModbusBus_t *bus, MiniModbusBusJob_t *job);
+
+/**
+ * Execute the due job with the highest priority (the most late one, between jobs of the same priority).
+ *
+ * @param bus the bus
+ * @param wait_us if not NULL, where to store the time till the next job is due, when no job was executed
+ * @return the result of the executed job, MiniModbusError_Pending if no job was due
+ */
+MiniModbusError_t MiniModbus_BusStep(MiniModbusBus_t *bus, uint32_t *wait_us);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_BUS_H */
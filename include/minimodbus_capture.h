@@ -0,0 +1,230 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_capture.h
+ * @brief a binary capture of polled values into a memory-mapped ring file, readable live by other processes
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_CAPTURE_H
+#define MINI_MODBUS_CAPTURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "minimodbus.h"
+
+/**
+ * first bytes of a capture file ("MMCP" in little endian), and version of the format
+ */
+#define MINI_MODBUS_CAPTURE_MAGIC 0x50434d4du
+#define MINI_MODBUS_CAPTURE_VERSION 1
+
+/**
+ * number of register values in a record: longer reads are split in more records
+ */
+#define MINI_MODBUS_CAPTURE_WORDS 52
+
+/**
+ * Header of a capture file, at offset 0. It takes a cache line, so that the head updated by the producer doesn't
+ * share it with the records.
+ */
+typedef struct MiniModbusCaptureHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+
+    /**
+     * number of records of the ring, a power of two
+     */
+    uint32_t capacity;
+    uint32_t reserved;
+
+    /**
+     * number of records written since the file was created. Record n is in slot n % capacity, and the last capacity
+     * records are available. Only written by the producer, with release semantics.
+     */
+    uint64_t head;
+
+    uint8_t padding[40];
+} MiniModbusCaptureHeader_t;
+
+/**
+ * A captured read. Records are stored in host byte order: a capture file is meant to be read on the same machine.
+ */
+typedef struct MiniModbusCaptureRecord {
+    /**
+     * n + 1 once record n is completely written, 0 while the producer is writing the slot
+     */
+    uint64_t sequence;
+
+    /**
+     * wall clock time of the read, in microseconds since the epoch
+     */
+    uint64_t timestamp_us;
+
+    /**
+     * device identifier chosen by the producer (for example an index in its list of devices)
+     */
+    uint16_t device;
+
+    /**
+     * function code of the read (0x03 or 0x04)
+     */
+    uint8_t function_code;
+
+    /**
+     * result of the read, a MiniModbusError_t. The values are meaningful only if it's MiniModbus_Success
+     */
+    int8_t error;
+
+    /**
+     * address of the first register and number of registers in values
+     */
+    uint16_t address;
+    uint16_t count;
+
+    /**
+     * raw register values
+     */
+    uint16_t values[MINI_MODBUS_CAPTURE_WORDS];
+} MiniModbusCaptureRecord_t;
+
+/**
+ * A capture file mapped in memory, either by the producer (MiniModbus_CaptureCreate()) or by a consumer
+ * (MiniModbus_CaptureOpen()). Owned by the caller.
+ */
+typedef struct MiniModbusCapture {
+    MiniModbusCaptureHeader_t *header;
+    MiniModbusCaptureRecord_t *records;
+
+    /* private fields */
+    size_t size;
+    uint64_t head;
+} MiniModbusCapture_t;
+
+/**
+ * Create (or truncate) a capture file and map it for writing. Only one producer can write a capture file.
+ *
+ * @param capture capture to initialize
+ * @param path path of the file. A file in /dev/shm is never written back to a disk.
+ * @param capacity number of records of the ring, a power of two
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_CaptureCreate(MiniModbusCapture_t *capture, const char *path, uint32_t capacity);
+
+/**
+ * Map an existing capture file read only, to consume its records. Any number of consumers can open a capture file,
+ * also while the producer is writing it.
+ *
+ * @param capture capture to initialize
+ * @param path path of the file
+ * @return MiniModbus_Success in case of success, MiniModbus_InvalidArgument if the file is not a capture file,
+ *         otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_CaptureOpen(MiniModbusCapture_t *capture, const char *path);
+
+/**
+ * Unmap a capture file.
+ *
+ * @param capture the capture
+ */
+void MiniModbus_CaptureClose(MiniModbusCapture_t *capture);
+
+/**
+ * Append a read to a capture. It's just a few stores in the mapped file, without system calls.
+ *
+ * @param capture a capture created with MiniModbus_CaptureCreate()
+ * @param device device identifier
+ * @param function_code function code of the read
+ * @param address address of the first register
+ * @param count number of registers (it takes count / MINI_MODBUS_CAPTURE_WORDS records, rounded up, at least one)
+ * @param values register values, can be NULL if error is not MiniModbus_Success
+ * @param error result of the read
+ */
+void MiniModbus_CaptureAppend(MiniModbusCapture_t *capture, uint16_t device, uint8_t function_code, uint16_t address,
+                              uint16_t count, const uint16_t *values, MiniModbusError_t error);
+
+/**
+ * Read holding registers (0x03) or input registers (0x04) with MiniModbus_ReadHoldingRegisters() or
+ * MiniModbus_ReadInputRegisters(), and append the result to a capture.
+ *
+ * @param capture a capture created with MiniModbus_CaptureCreate()
+ * @param ctx the context
+ * @param device device identifier stored in the records
+ * @param function_code 0x03 or 0x04
+ * @param reg address of the first register
+ * @param quantity number of registers
+ * @param values where to store the values
+ * @return the result of the read
+ */
+MiniModbusError_t MiniModbus_CaptureRead(MiniModbusCapture_t *capture, MiniModbusContext_t *ctx, uint16_t device,
+                                         uint8_t function_code, uint16_t reg, uint16_t quantity, uint16_t *values);
+
+/**
+ * Number of records written so far. The records from MiniModbus_CaptureOldest() to this number (excluded) can be
+ * read.
+ *
+ * @param capture the capture
+ * @return the sequence number of the next record that will be written
+ */
+uint64_t MiniModbus_CaptureHead(const MiniModbusCapture_t *capture);
+
+/**
+ * Oldest record that is still in the ring.
+ *
+ * @param capture the capture
+ * @param head a value returned by MiniModbus_CaptureHead()
+ * @return the sequence number of the oldest record
+ */
+uint64_t MiniModbus_CaptureOldest(const MiniModbusCapture_t *capture, uint64_t head);
+
+/**
+ * Get a record, in place in the mapped file. The producer can overwrite it at any time: after using its fields, call
+ * MiniModbus_CaptureValid() to check that what was read is consistent.
+ *
+ * @param capture the capture
+ * @param sequence sequence number of the record
+ * @return the record, or NULL if it was overwritten or is being written
+ */
+const MiniModbusCaptureRecord_t *MiniModbus_CaptureRecord(const MiniModbusCapture_t *capture, uint64_t sequence);
+
+/**
+ * Check that a record returned by MiniModbus_CaptureRecord() was not overwritten while its fields were read.
+ *
+ * @param record the record
+ * @param sequence sequence number of the record
+ * @return 1 if the record is still valid, 0 if the fields read must be discarded
+ */
+int MiniModbus_CaptureValid(const MiniModbusCaptureRecord_t *record, uint64_t sequence);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_CAPTURE_H */
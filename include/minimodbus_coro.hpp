@@ -0,0 +1,724 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_coro.hpp
+ * @brief optional C++20 layer: coroutine clients driven by a single threaded epoll event loop (Linux only)
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_CORO_HPP
+#define MINI_MODBUS_CORO_HPP
+
+#include "minimodbus.h"
+
+#include <climits>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace minimodbus {
+
+class Client;
+
+namespace detail {
+
+constexpr int MAX_EVENTS = 64;
+
+/*
+ * A timer of the event loop. Timers are kept in circular lists with a sentinel, so that a timer can be disarmed
+ * without knowing which list it is in.
+ */
+struct Timer {
+    Timer *prev = nullptr;
+    Timer *next = nullptr;
+    uint64_t deadline_ms = 0;
+    void (*expire)(Timer *timer) = nullptr;
+    void *owner = nullptr;
+
+    void MakeSentinel() noexcept
+    {
+        prev = this;
+        next = this;
+    }
+
+    void LinkBefore(Timer *position) noexcept
+    {
+        prev = position->prev;
+        next = position;
+        position->prev->next = this;
+        position->prev = this;
+    }
+
+    void Unlink() noexcept
+    {
+        if (next != nullptr) {
+            prev->next = next;
+            next->prev = prev;
+            prev = nullptr;
+            next = nullptr;
+        }
+    }
+};
+
+inline uint64_t NowMs() noexcept
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// the context never calls the transport callbacks in non-blocking mode
+inline int NoTransportReceive(void *, void *, size_t)
+{
+    return -1;
+}
+
+inline int NoTransportSend(void *, const void *, size_t)
+{
+    return -1;
+}
+
+} // namespace detail
+
+/**
+ * Return type of a detached coroutine: it starts running right away, and its frame is freed when it returns.
+ */
+struct Task {
+    struct promise_type {
+        Task get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+/**
+ * A minimal executor: a single thread waits the sockets of the clients with epoll, and resumes the coroutines whose
+ * requests completed or whose timers expired. All the clients, timers and coroutines of a loop belong to the thread
+ * that runs it.
+ */
+class EventLoop {
+public:
+    EventLoop() noexcept
+        : epoll_fd_(epoll_create1(EPOLL_CLOEXEC))
+    {
+        timers_.MakeSentinel();
+    }
+
+    ~EventLoop()
+    {
+        if (epoll_fd_ >= 0) {
+            close(epoll_fd_);
+        }
+    }
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    /**
+     * @return false if the epoll instance could not be created
+     */
+    bool Valid() const noexcept
+    {
+        return epoll_fd_ >= 0;
+    }
+
+    /**
+     * Run the loop in the calling thread till Stop() is called.
+     */
+    void Run() noexcept;
+
+    /**
+     * Make Run() return, after the events being processed. Must be called from the thread of the loop, for example
+     * from a coroutine.
+     */
+    void Stop() noexcept
+    {
+        running_ = false;
+    }
+
+private:
+    friend class Client;
+    friend class Sleep;
+
+    bool Watch(int fd, uint32_t events, Client *client, bool add) noexcept
+    {
+        struct epoll_event event = {};
+        event.events = events;
+        event.data.ptr = client;
+
+        return epoll_ctl(epoll_fd_, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) == 0;
+    }
+
+    void Forget(int fd, Client *client) noexcept
+    {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+        // the events of the client still to process in this round are stale
+        for (int i = 0; i < batch_count_; i++) {
+            if (batch_[i].data.ptr == client) {
+                batch_[i].data.ptr = nullptr;
+            }
+        }
+    }
+
+    void Arm(detail::Timer *timer, uint32_t timeout_ms) noexcept
+    {
+        timer->Unlink();
+        timer->deadline_ms = detail::NowMs() + timeout_ms;
+        timer->LinkBefore(&timers_);
+        if (timer->deadline_ms < next_deadline_ms_) {
+            next_deadline_ms_ = timer->deadline_ms;
+        }
+    }
+
+    /*
+     * Expire the due timers. The timers are only scanned when the earliest deadline is due, so a wakeup for socket
+     * events costs nothing however many timers are armed.
+     */
+    void RunTimers(uint64_t now) noexcept
+    {
+        if (now < next_deadline_ms_) {
+            return;
+        }
+
+        detail::Timer expired;
+        expired.MakeSentinel();
+        next_deadline_ms_ = UINT64_MAX;
+        for (detail::Timer *timer = timers_.next; timer != &timers_;) {
+            detail::Timer *following = timer->next;
+            if (timer->deadline_ms <= now) {
+                timer->Unlink();
+                timer->LinkBefore(&expired);
+            } else if (timer->deadline_ms < next_deadline_ms_) {
+                next_deadline_ms_ = timer->deadline_ms;
+            }
+            timer = following;
+        }
+
+        // an expired timer can disarm the others, that just leave this list
+        while (expired.next != &expired) {
+            detail::Timer *timer = expired.next;
+            timer->Unlink();
+            timer->expire(timer);
+        }
+    }
+
+    int NextTimeout(uint64_t now) const noexcept
+    {
+        if (next_deadline_ms_ == UINT64_MAX) {
+            return -1;
+        }
+        if (next_deadline_ms_ <= now) {
+            return 0;
+        }
+
+        return next_deadline_ms_ - now > INT_MAX ? INT_MAX : (int)(next_deadline_ms_ - now);
+    }
+
+    int epoll_fd_;
+    bool running_ = false;
+    detail::Timer timers_;
+    uint64_t next_deadline_ms_ = UINT64_MAX;
+    struct epoll_event *batch_ = nullptr;
+    int batch_count_ = 0;
+};
+
+/**
+ * Awaitable that resumes the coroutine after the given time, on the thread of the loop.
+ */
+class Sleep {
+public:
+    Sleep(EventLoop &loop, uint32_t timeout_ms) noexcept
+        : loop_(loop)
+        , timeout_ms_(timeout_ms)
+    {
+    }
+
+    ~Sleep()
+    {
+        timer_.Unlink();
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+        handle_ = handle;
+        timer_.owner = this;
+        timer_.expire = [](detail::Timer *timer) { static_cast<Sleep *>(timer->owner)->handle_.resume(); };
+        loop_.Arm(&timer_, timeout_ms_);
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+
+private:
+    EventLoop &loop_;
+    uint32_t timeout_ms_;
+    detail::Timer timer_;
+    std::coroutine_handle<> handle_;
+};
+
+/**
+ * Awaitable request of a client. co_await gives its result: the values are stored where the request says once it
+ * completes successfully.
+ */
+class Request {
+public:
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept;
+
+    MiniModbusError_t await_resume() const noexcept
+    {
+        return result_;
+    }
+
+private:
+    friend class Client;
+
+    enum Operation {
+        ReadHoldingRegisters,
+        ReadInputRegisters,
+        WriteSingleRegister,
+        WriteMultipleRegisters,
+    };
+
+    Request(Client *client, Operation operation, uint16_t reg, uint16_t quantity, uint16_t *values,
+            const uint16_t *write_values) noexcept
+        : client_(client)
+        , operation_(operation)
+        , reg_(reg)
+        , quantity_(quantity)
+        , values_(values)
+        , write_values_(write_values)
+    {
+    }
+
+    Client *client_;
+    Operation operation_;
+    uint16_t reg_;
+    uint16_t quantity_;
+    uint16_t *values_;
+    const uint16_t *write_values_;
+    MiniModbusError_t result_ = MiniModbusError_Pending;
+    std::coroutine_handle<> handle_;
+    Request *next_ = nullptr;
+};
+
+/**
+ * A Modbus session on a connected socket, driven by the non-blocking API of a context. Requests are awaited by
+ * coroutines: more coroutines can share a client, their requests are sent one at a time in order. Each request,
+ * response included, has to complete within the timeout of the client.
+ * The client must not be destroyed while requests are in progress. It never closes the socket.
+ */
+class Client {
+public:
+    Client(EventLoop &loop, MiniModbusMode_t mode, uint8_t slave_address) noexcept
+        : loop_(loop)
+    {
+        MiniModbusConfig_t config = {};
+        config.mode = mode;
+        config.slave_address = slave_address;
+        config.receive = detail::NoTransportReceive;
+        config.send = detail::NoTransportSend;
+        MiniModbus_Init(&ctx_, &config);
+
+        timer_.owner = this;
+        timer_.expire = [](detail::Timer *timer) { static_cast<Client *>(timer->owner)->Expire(); };
+    }
+
+    ~Client()
+    {
+        Detach();
+    }
+
+    Client(const Client &) = delete;
+    Client &operator=(const Client &) = delete;
+
+    /**
+     * Start using a connected, non-blocking socket.
+     *
+     * @param fd the socket
+     * @return MiniModbus_InvalidArgument if a socket is already attached or it can't be watched, otherwise
+     *         MiniModbus_Success
+     */
+    MiniModbusError_t Attach(int fd) noexcept
+    {
+        if (fd_ >= 0 || !loop_.Watch(fd, EPOLLIN, this, true)) {
+            return MiniModbusError_InvalidArgument;
+        }
+
+        fd_ = fd;
+        sending_ = false;
+
+        return MiniModbusError_Success;
+    }
+
+    /**
+     * Stop using the socket, for example to close it. A request in progress fails with MiniModbusError_Send,
+     * and so do the following ones till a socket is attached again.
+     */
+    void Detach() noexcept
+    {
+        Unwatch();
+        if (queue_ != nullptr && frame_ != nullptr) {
+            MiniModbus_AsyncCancel(&ctx_);
+            Complete(MiniModbusError_Send);
+        }
+    }
+
+    /**
+     * Set the time a request can take, 1 s by default.
+     */
+    void SetTimeout(uint32_t timeout_ms) noexcept
+    {
+        timeout_ms_ = timeout_ms;
+    }
+
+    /**
+     * The context of the client, for example to change the slave address between requests or to get its statistics.
+     */
+    MiniModbusContext_t *Context() noexcept
+    {
+        return &ctx_;
+    }
+
+    Request ReadHoldingRegisters(uint16_t reg, uint16_t quantity, uint16_t *values) noexcept
+    {
+        return Request(this, Request::ReadHoldingRegisters, reg, quantity, values, nullptr);
+    }
+
+    Request ReadInputRegisters(uint16_t reg, uint16_t quantity, uint16_t *values) noexcept
+    {
+        return Request(this, Request::ReadInputRegisters, reg, quantity, values, nullptr);
+    }
+
+    Request WriteSingleRegister(uint16_t reg, uint16_t value) noexcept
+    {
+        return Request(this, Request::WriteSingleRegister, reg, value, nullptr, nullptr);
+    }
+
+    Request WriteMultipleRegisters(uint16_t reg, uint16_t quantity, const uint16_t *values) noexcept
+    {
+        return Request(this, Request::WriteMultipleRegisters, reg, quantity, nullptr, values);
+    }
+
+private:
+    friend class EventLoop;
+    friend class Request;
+
+    void Unwatch() noexcept
+    {
+        if (fd_ >= 0) {
+            loop_.Forget(fd_, this);
+            fd_ = -1;
+            sending_ = false;
+        }
+    }
+
+    /*
+     * Queue a request, starting it if the client is idle. Returns false if it failed right away, without suspending
+     * the coroutine.
+     */
+    bool Enqueue(Request *request) noexcept
+    {
+        request->next_ = nullptr;
+        if (queue_ != nullptr) {
+            queue_tail_->next_ = request;
+            queue_tail_ = request;
+            return true;
+        }
+
+        queue_ = request;
+        queue_tail_ = request;
+
+        MiniModbusError_t error = Begin(request);
+        if (error != MiniModbusError_Success) {
+            Pop()->result_ = error;
+            return false;
+        }
+
+        return true;
+    }
+
+    Request *Pop() noexcept
+    {
+        Request *request = queue_;
+        queue_ = request->next_;
+        if (queue_ == nullptr) {
+            queue_tail_ = nullptr;
+        }
+
+        return request;
+    }
+
+    /*
+     * Encode a request and start sending it.
+     */
+    MiniModbusError_t Begin(Request *request) noexcept
+    {
+        if (fd_ < 0) {
+            return MiniModbusError_Send;
+        }
+
+        MiniModbusError_t error = MiniModbusError_InvalidArgument;
+        switch (request->operation_) {
+        case Request::ReadHoldingRegisters:
+            error = MiniModbus_AsyncReadHoldingRegisters(&ctx_, request->reg_, request->quantity_, request->values_,
+                                                         &frame_, &frame_length_);
+            break;
+        case Request::ReadInputRegisters:
+            error = MiniModbus_AsyncReadInputRegisters(&ctx_, request->reg_, request->quantity_, request->values_,
+                                                       &frame_, &frame_length_);
+            break;
+        case Request::WriteSingleRegister:
+            error = MiniModbus_AsyncWriteSingleRegister(&ctx_, request->reg_, request->quantity_, &frame_,
+                                                        &frame_length_);
+            break;
+        case Request::WriteMultipleRegisters:
+            error = MiniModbus_AsyncWriteMultipleRegisters(&ctx_, request->reg_, request->quantity_,
+                                                           request->write_values_, &frame_, &frame_length_);
+            break;
+        }
+        if (error != MiniModbusError_Success) {
+            return error;
+        }
+
+        sent_ = 0;
+        loop_.Arm(&timer_, timeout_ms_);
+
+        error = Send();
+        if (error != MiniModbusError_Success && error != MiniModbusError_Pending) {
+            MiniModbus_AsyncCancel(&ctx_);
+            timer_.Unlink();
+            return error;
+        }
+
+        return MiniModbusError_Success;
+    }
+
+    /*
+     * Send as much of the request as the socket takes, watching for it to become writable if it doesn't take all.
+     */
+    MiniModbusError_t Send() noexcept
+    {
+        while (sent_ < frame_length_) {
+            ssize_t result = send(fd_, frame_ + sent_, frame_length_ - sent_, MSG_NOSIGNAL);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (!sending_) {
+                    sending_ = loop_.Watch(fd_, EPOLLIN | EPOLLOUT, this, false);
+                }
+                return MiniModbusError_Pending;
+            }
+            if (result < 0) {
+                return MiniModbusError_Send;
+            }
+            sent_ += result;
+        }
+
+        if (sending_) {
+            loop_.Watch(fd_, EPOLLIN, this, false);
+            sending_ = false;
+        }
+
+        return MiniModbusError_Success;
+    }
+
+    /*
+     * Complete the request in progress, start the next one, then resume the coroutine of the completed one. Queued
+     * requests that fail to start are completed as well. All of them are moved to a local list before resuming the
+     * first coroutine: nothing of the client is used after that, since the coroutine may destroy the client or
+     * enqueue new requests.
+     */
+    void Complete(MiniModbusError_t error) noexcept
+    {
+        Request *completed = Pop();
+        Request *completed_tail = completed;
+        completed->result_ = error;
+        completed->next_ = nullptr;
+        timer_.Unlink();
+        frame_ = nullptr;
+        if (sending_) {
+            loop_.Watch(fd_, EPOLLIN, this, false);
+            sending_ = false;
+        }
+
+        while (queue_ != nullptr) {
+            MiniModbusError_t next_error = Begin(queue_);
+            if (next_error == MiniModbusError_Success) {
+                break;
+            }
+            Request *failed = Pop();
+            failed->result_ = next_error;
+            failed->next_ = nullptr;
+            completed_tail->next_ = failed;
+            completed_tail = failed;
+        }
+
+        // the request lives in the frame of its coroutine: read the next one before resuming it
+        while (completed != nullptr) {
+            Request *next = completed->next_;
+            completed->handle_.resume();
+            completed = next;
+        }
+    }
+
+    void Expire() noexcept
+    {
+        MiniModbus_AsyncCancel(&ctx_);
+        Complete(MiniModbusError_Timeout);
+    }
+
+    void HandleEvent(uint32_t events) noexcept
+    {
+        bool in_progress = queue_ != nullptr && frame_ != nullptr;
+
+        if (in_progress && sent_ < frame_length_ && (events & EPOLLOUT) != 0) {
+            MiniModbusError_t error = Send();
+            if (error != MiniModbusError_Success && error != MiniModbusError_Pending) {
+                MiniModbus_AsyncCancel(&ctx_);
+                Complete(error);
+                return;
+            }
+        }
+
+        if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) == 0) {
+            return;
+        }
+
+        uint8_t data[MINI_MODBUS_MAX_FRAME_SIZE];
+        ssize_t received = read(fd_, data, sizeof(data));
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            return;
+        }
+        if (received <= 0) {
+            // the peer closed the connection: nothing will arrive anymore
+            Unwatch();
+            if (in_progress) {
+                MiniModbus_AsyncCancel(&ctx_);
+                Complete(MiniModbusError_Receive);
+            }
+            return;
+        }
+
+        // bytes of a late response, or received before the request was fully sent, are dropped
+        if (!in_progress || sent_ < frame_length_) {
+            return;
+        }
+
+        // as are bytes after the end of the response
+        MiniModbusError_t error = MiniModbus_AsyncFeed(&ctx_, data, received, nullptr);
+        if (error != MiniModbusError_Pending) {
+            Complete(error);
+        }
+    }
+
+    EventLoop &loop_;
+    MiniModbusContext_t ctx_;
+    int fd_ = -1;
+    uint32_t timeout_ms_ = 1000;
+    detail::Timer timer_;
+    Request *queue_ = nullptr;
+    Request *queue_tail_ = nullptr;
+    const uint8_t *frame_ = nullptr;
+    size_t frame_length_ = 0;
+    size_t sent_ = 0;
+    bool sending_ = false;
+};
+
+inline bool Request::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+    handle_ = handle;
+
+    return client_->Enqueue(this);
+}
+
+inline void EventLoop::Run() noexcept
+{
+    struct epoll_event events[detail::MAX_EVENTS];
+
+    running_ = true;
+    while (running_) {
+        int count = epoll_wait(epoll_fd_, events, detail::MAX_EVENTS, NextTimeout(detail::NowMs()));
+
+        batch_ = events;
+        batch_count_ = count > 0 ? count : 0;
+        for (int i = 0; i < batch_count_; i++) {
+            Client *client = static_cast<Client *>(events[i].data.ptr);
+            if (client != nullptr) {
+                client->HandleEvent(events[i].events);
+            }
+        }
+        batch_ = nullptr;
+        batch_count_ = 0;
+
+        RunTimers(detail::NowMs());
+    }
+}
+
+} // namespace minimodbus
+
+#endif /* MINI_MODBUS_CORO_HPP */
@@ -0,0 +1,189 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_gateway.h
+ * @brief a Linux engine that polls many Modbus TCP devices from a fixed pool of epoll driven worker threads
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_GATEWAY_H
+#define MINI_MODBUS_GATEWAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "minimodbus.h"
+
+/**
+ * A Modbus TCP device polled by the gateway. The object is owned by the caller: set the configuration fields after
+ * MiniModbus_GatewayDeviceInit(), and don't touch it while the gateway is running except from the callback.
+ */
+typedef struct MiniModbusGatewayDevice {
+    /**
+     * address of the device
+     */
+    struct sockaddr_storage address;
+    socklen_t address_length;
+
+    /**
+     * poll plan executed every period. Build it with the context of the device (see MiniModbus_GatewayDeviceInit()).
+     */
+    MiniModbusPollPlan_t *plan;
+
+    /**
+     * poll period, in milliseconds. A cycle that takes longer delays the next one, no cycles are queued.
+     */
+    uint32_t period_ms;
+
+    /**
+     * maximum time to wait for a response, in milliseconds. On timeout the connection is closed and reopened, since
+     * a late response could be mistaken for the one of the next request.
+     */
+    uint32_t timeout_ms;
+
+    /**
+     * delay before reconnecting after the connection failed, in milliseconds: it's doubled after each failure,
+     * up to reconnect_max_ms, and reset by a successful poll cycle
+     */
+    uint32_t reconnect_min_ms;
+    uint32_t reconnect_max_ms;
+
+    /**
+     * function called, from the worker thread, at the end of each poll cycle. Can be NULL.
+     *
+     * @param device the device
+     * @param result MiniModbus_Success if all the blocks were read, otherwise the first error (the result of each
+     *               block is in the plan)
+     */
+    void (*on_poll)(struct MiniModbusGatewayDevice *device, MiniModbusError_t result);
+
+    /**
+     * a pointer to data that may be used in the callback
+     */
+    void *user_data;
+
+    /**
+     * statistics
+     */
+    unsigned long cycles;
+    unsigned long failed_cycles;
+    unsigned long connects;
+
+    /* private fields */
+    MiniModbusContext_t ctx;
+    struct MiniModbusGatewayDevice *next;
+    int fd;
+    int state;
+    uint64_t next_time_ms;
+    uint64_t deadline_ms;
+    uint32_t backoff_ms;
+    size_t block;
+    MiniModbusError_t cycle_result;
+    const uint8_t *frame;
+    size_t frame_length;
+    size_t frame_sent;
+    uint16_t values[MINI_MODBUS_MAX_READ_REGISTERS];
+} MiniModbusGatewayDevice_t;
+
+/**
+ * A worker thread of the gateway, with its own epoll instance and its share of the devices. Opaque structure.
+ */
+typedef struct MiniModbusGatewayWorker {
+    struct MiniModbusGateway *gateway;
+    MiniModbusGatewayDevice_t *devices;
+    size_t device_count;
+    pthread_t thread;
+    int epoll_fd;
+    int wakeup_fd;
+    int cpu;
+    int started;
+} MiniModbusGatewayWorker_t;
+
+/**
+ * The gateway. Opaque structure.
+ */
+typedef struct MiniModbusGateway {
+    MiniModbusGatewayWorker_t *workers;
+    size_t worker_count;
+    size_t next_worker;
+    int running;
+} MiniModbusGateway_t;
+
+/**
+ * Initialize a gateway.
+ *
+ * @param gateway gateway to initialize
+ * @param workers caller owned array of workers, one thread each
+ * @param worker_count number of workers
+ * @param pin_cpus if not 0, worker i is pinned to CPU i (modulo the number of CPUs)
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_GatewayInit(MiniModbusGateway_t *gateway, MiniModbusGatewayWorker_t *workers,
+                                         size_t worker_count, int pin_cpus);
+
+/**
+ * Initialize a device with default timings (1 s period and timeout, reconnect backoff from 100 ms to 30 s).
+ *
+ * @param device device to initialize
+ * @param slave_address unit identifier of the device
+ * @return the context of the device, to build its poll plan
+ */
+MiniModbusContext_t *MiniModbus_GatewayDeviceInit(MiniModbusGatewayDevice_t *device, uint8_t slave_address);
+
+/**
+ * Add a device to the gateway, assigning it to a worker. Must be called before MiniModbus_GatewayStart().
+ *
+ * @param gateway the gateway
+ * @param device the device
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_GatewayAddDevice(MiniModbusGateway_t *gateway, MiniModbusGatewayDevice_t *device);
+
+/**
+ * Start the worker threads. Each device connects and starts polling right away.
+ *
+ * @param gateway the gateway
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_GatewayStart(MiniModbusGateway_t *gateway);
+
+/**
+ * Stop the worker threads and close all the connections. Can't be called from a callback.
+ *
+ * @param gateway the gateway
+ */
+void MiniModbus_GatewayStop(MiniModbusGateway_t *gateway);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_GATEWAY_H */
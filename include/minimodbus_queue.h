@@ -0,0 +1,204 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_queue.h
+ * @brief a Linux lock-free request queue, to share a context between threads through a single I/O thread
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_QUEUE_H
+#define MINI_MODBUS_QUEUE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <pthread.h>
+
+#include "minimodbus.h"
+
+/**
+ * A request submitted to a queue. The object is owned by the caller and must stay valid until the request completes.
+ * Set the request fields, submit it with MiniModbus_QueueSubmit(), and either wait for it with MiniModbus_QueueWait()
+ * or get the callback. It can be submitted again once it's completed.
+ */
+typedef struct MiniModbusQueueJob {
+    /**
+     * function code of the request: 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x0F, 0x10 or 0x17. Ignored if execute is
+     * set.
+     */
+    uint8_t function_code;
+
+    /**
+     * first address and number of registers or coils
+     */
+    uint16_t reg;
+    uint16_t quantity;
+
+    /**
+     * values read or written, quantity elements: uint16_t for registers, and one uint8_t per coil or discrete input
+     * (0 or 1 when read, ON if not 0 when written). Single writes (0x05, 0x06) write the first value.
+     */
+    void *values;
+
+    /**
+     * registers written by a read/write multiple registers request (0x17)
+     */
+    uint16_t write_reg;
+    uint16_t write_quantity;
+    const uint16_t *write_values;
+
+    /**
+     * optional function executed instead of the request, to run anything on the context (a frame, a poll plan, more
+     * transactions in a row). Can be NULL.
+     *
+     * @param ctx the context of the queue
+     * @param job the job
+     * @return the result of the job
+     */
+    MiniModbusError_t (*execute)(MiniModbusContext_t *ctx, struct MiniModbusQueueJob *job);
+
+    /**
+     * function called, from the I/O thread, when the request completes. Can be NULL. It's safe to submit new jobs
+     * (including this one) from the callback, but the callback must not block: it delays all the other requests.
+     * A job with a callback must not be waited with MiniModbus_QueueWait().
+     *
+     * @param job the completed job
+     */
+    void (*callback)(struct MiniModbusQueueJob *job);
+
+    /**
+     * a pointer to data that may be used in the callback
+     */
+    void *user_data;
+
+    /**
+     * result of the request: MiniModbusError_Pending till it completes
+     */
+    MiniModbusError_t result;
+
+    /* private fields */
+    uint32_t state;
+} MiniModbusQueueJob_t;
+
+/**
+ * A slot of the ring of a queue
+ */
+typedef struct MiniModbusQueueSlot {
+    uint64_t sequence;
+    MiniModbusQueueJob_t *job;
+} MiniModbusQueueSlot_t;
+
+/**
+ * A queue of requests, executed in order on a context by a dedicated I/O thread. Any thread can submit requests
+ * without locks: the bounded ring is a multi-producer single-consumer queue, and submitting fails instead of waiting
+ * when it's full. The I/O thread is the only user of the context. Opaque structure.
+ */
+typedef struct MiniModbusQueue {
+    MiniModbusContext_t *ctx;
+    MiniModbusQueueSlot_t *slots;
+    uint64_t mask;
+    pthread_t thread;
+    uint32_t running;
+    uint32_t sleeping;
+
+    /**
+     * statistics, updated by the I/O thread
+     */
+    unsigned long completed;
+    unsigned long sleeps;
+
+    /* private fields: the positions of the producers and of the consumer are kept on separate cache lines */
+    uint8_t padding0[64];
+    uint64_t head;
+    uint8_t padding1[64];
+    uint64_t tail;
+    uint8_t padding2[64];
+} MiniModbusQueue_t;
+
+/**
+ * Initialize a queue.
+ *
+ * @param queue queue to initialize
+ * @param ctx an initialized context. Once the queue is started only the I/O thread may use it
+ * @param slots caller owned array of slots, the maximum number of queued requests
+ * @param slot_count number of elements of slots, a power of two
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_QueueInit(MiniModbusQueue_t *queue, MiniModbusContext_t *ctx,
+                                       MiniModbusQueueSlot_t *slots, size_t slot_count);
+
+/**
+ * Start the I/O thread.
+ *
+ * @param queue the queue
+ * @return MiniModbus_Success in case of success, otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_QueueStart(MiniModbusQueue_t *queue);
+
+/**
+ * Stop the I/O thread, after it has executed all the requests already submitted. No requests may be submitted
+ * meanwhile, and it can't be called from a callback.
+ *
+ * @param queue the queue
+ */
+void MiniModbus_QueueStop(MiniModbusQueue_t *queue);
+
+/**
+ * Submit a request. It never blocks: it's a few atomic operations, plus a system call to wake up the I/O thread if
+ * it's idle.
+ *
+ * @param queue a started queue
+ * @param job the request, not already pending
+ * @return MiniModbus_Success if the request was queued, MiniModbusError_QueueFull if the ring is full (the request
+ *         is not queued and its callback will not be called), otherwise appropriate error code
+ */
+MiniModbusError_t MiniModbus_QueueSubmit(MiniModbusQueue_t *queue, MiniModbusQueueJob_t *job);
+
+/**
+ * Wait for a submitted request to complete. Only the calling thread is blocked, till the I/O thread completes this
+ * request.
+ *
+ * @param job a submitted job
+ * @return the result of the request
+ */
+MiniModbusError_t MiniModbus_QueueWait(MiniModbusQueueJob_t *job);
+
+/**
+ * Submit a request and wait for it to complete, as the blocking API does on a context of its own.
+ *
+ * @param queue a started queue
+ * @param job the request, not already pending
+ * @return the result of the request, or MiniModbusError_QueueFull if the ring is full
+ */
+MiniModbusError_t MiniModbus_QueueExecute(MiniModbusQueue_t *queue, MiniModbusQueueJob_t *job);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_QUEUE_H */
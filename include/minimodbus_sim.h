@@ -0,0 +1,170 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * @file minimodbus_sim.h
+ * @brief an in-memory simulated slave and loopback transport, to test and benchmark the library without a device
+ * @author Alessandro Righi
+ * @copyright 2021-2022
+ */
+
+#ifndef MINI_MODBUS_SIM_H
+#define MINI_MODBUS_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include "minimodbus.h"
+
+/**
+ * A simulated slave, built on the MiniModbus server. The send callback of the loopback transport hands the request
+ * directly to the slave, that prepares the response for the following receive calls: everything happens in the
+ * calling thread.
+ */
+typedef struct MiniModbusSim {
+    /**
+     * framing used by the slave (TCP/IP or RTU)
+     */
+    MiniModbusMode_t mode;
+
+    /**
+     * address of the slave. In RTU mode requests for other addresses are ignored.
+     */
+    uint8_t slave_address;
+
+    /**
+     * the server that executes the requests. MiniModbusSim_Init() maps the registers both as holding and input
+     * registers: other tables (coils, discrete inputs) and write hooks can be set after it.
+     */
+    MiniModbusServer_t server;
+
+    /**
+     * time the slave takes to answer each request, in microseconds
+     */
+    uint32_t latency_us;
+
+    /**
+     * probability, in parts per million, that a request gets no response
+     */
+    uint32_t drop_rate_ppm;
+
+    /**
+     * probability, in parts per million, that a response is corrupted
+     * (wrong CRC in RTU mode, wrong transaction identifier in TCP mode)
+     */
+    uint32_t corrupt_rate_ppm;
+
+    /**
+     * probability, in parts per million, that a request is answered with a server device busy exception
+     */
+    uint32_t exception_rate_ppm;
+
+    /**
+     * statistics, reset by MiniModbusSim_Init()
+     */
+    unsigned long send_calls;
+    unsigned long receive_calls;
+    unsigned long requests;
+    unsigned long injected_errors;
+
+    /* private fields */
+    uint32_t random_state;
+    size_t response_length;
+    size_t response_position;
+    uint8_t response[MINI_MODBUS_MAX_FRAME_SIZE];
+} MiniModbusSim_t;
+
+/**
+ * Initialize a simulated slave, without latency and injected errors.
+ *
+ * @param sim simulated slave to initialize
+ * @param mode framing to use
+ * @param slave_address address of the slave
+ * @param registers registers of the slave, must stay valid while the slave is used
+ * @param register_count number of registers
+ */
+void MiniModbusSim_Init(MiniModbusSim_t *sim, MiniModbusMode_t mode, uint8_t slave_address, uint16_t *registers,
+                        size_t register_count);
+
+/**
+ * Fill a MiniModbus configuration to talk with the simulated slave through the loopback transport.
+ *
+ * @param sim simulated slave
+ * @param config configuration to fill
+ */
+void MiniModbusSim_Config(MiniModbusSim_t *sim, MiniModbusConfig_t *config);
+
+/**
+ * Loopback transport callbacks, with a pointer to the simulated slave as user_data.
+ * Receive fails if more bytes are requested than the slave has to send, as a timeout would on a real transport.
+ */
+int MiniModbusSim_Send(void *user_data, const void *data, size_t length);
+int MiniModbusSim_Sendv(void *user_data, const MiniModbusIoVec_t *iov, size_t iov_count);
+int MiniModbusSim_Receive(void *user_data, void *data, size_t length);
+
+/**
+ * Loopback receive callback that works as read(2), returning all the bytes the slave has to send (up to length), for
+ * use with a buffered transport (see MiniModbus_BufferedTransportInit()). Fails if there is nothing to read.
+ */
+int MiniModbusSim_Read(void *user_data, void *data, size_t length);
+
+/**
+ * Loopback receive with timeout, returning the bytes the slave has to send (up to length): when they are less than
+ * length the timeout expires right away. Works both as receive_timeout of a config and of a buffered transport.
+ */
+int MiniModbusSim_ReceiveTimeout(void *user_data, void *data, size_t length, uint32_t timeout_us);
+
+/**
+ * Loopback flush callback, discarding what is left of the response.
+ */
+void MiniModbusSim_Flush(void *user_data);
+
+/**
+ * Create a TCP socket listening on the loopback interface, to serve a simulated slave to real clients.
+ *
+ * @param port port to listen on, 0 to let the system choose one
+ * @param bound_port pointer where to store the port actually used, can be NULL
+ * @return the listening socket, or -1 in case of error
+ */
+int MiniModbusSim_TcpListen(uint16_t port, uint16_t *bound_port);
+
+/**
+ * Serve Modbus TCP clients connected to a listening socket with a server, till *running becomes 0.
+ * All the clients are served by the calling thread, and pipelined requests are supported.
+ *
+ * @param server the server that executes the requests
+ * @param listen_fd listening socket
+ * @param max_clients maximum number of clients connected at the same time
+ * @param running flag checked at least every 100 ms
+ * @return 0 when stopped, -1 in case of error
+ */
+int MiniModbusSim_TcpServe(MiniModbusServer_t *server, int listen_fd, size_t max_clients, const volatile int *running);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* MINI_MODBUS_SIM_H */
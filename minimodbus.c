@@ -27,13 +27,219 @@
 
 #include <string.h>
 
+#if defined(MINI_MODBUS_FAST_CRC) && defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MINI_MODBUS_HAVE_CLMUL
+#include <wmmintrin.h>
+#endif
+
+// the vector word order conversions are byte permutations, that hold only on little endian hosts
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#if defined(__SSE2__)
+#define MINI_MODBUS_HAVE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__ARM_ARCH_ISA_A64)
+#define MINI_MODBUS_HAVE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#define FUNCTION_READ_COILS 0x01
+#define FUNCTION_READ_DISCRETE_INPUTS 0x02
 #define FUNCTION_READ_HOLDING_REGISTER 0x03
+#define FUNCTION_READ_INPUT_REGISTER 0x04
+#define FUNCTION_WRITE_SINGLE_COIL 0x05
 #define FUNCTION_WRITE_SINGLE_REGISTER 0x06
+#define FUNCTION_WRITE_MULTIPLE_COILS 0x0F
+#define FUNCTION_WRITE_MULTIPLE_REGISTERS 0x10
+#define FUNCTION_READ_WRITE_MULTIPLE_REGISTERS 0x17
 #define ERROR_CODE_BITMASK 0x80
 #define RESPONSE_HEADER_LENGTH 2
 #define MODBUS_TCP_IP_PROTOCOL_IDENTIFIER 0
+#define MODBUS_RTU_FRAME_OVERHEAD 3 // slave address + 2 byte CRC
+#define MODBUS_TCP_FRAME_OVERHEAD 7 // MBAP header
+#define MODBUS_RTU_BROADCAST_ADDRESS 0
+#define MODBUS_TCP_ANY_UNIT_IDENTIFIER 0xFF
+#define MODBUS_COIL_ON 0xFF00
+
+#ifdef MINI_MODBUS_FAST_CRC
+/*
+ * Tables for the slicing-by-8 algorithm: MiniModbus_Crc16SlicingTable[k][b] is the CRC of the byte b followed by k
+ * zero bytes. The first table is the same as the byte at a time one.
+ */
+static const uint16_t MiniModbus_Crc16SlicingTable[8][256] = {
+    {
+        0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241, 0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1,
+        0xC481, 0x0440, 0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40, 0x0A00, 0xCAC1, 0xCB81, 0x0B40,
+        0xC901, 0x09C0, 0x0880, 0xC841, 0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40, 0x1E00, 0xDEC1,
+        0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41, 0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+        0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040, 0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1,
+        0xF281, 0x3240, 0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441, 0x3C00, 0xFCC1, 0xFD81, 0x3D40,
+        0xFF01, 0x3FC0, 0x3E80, 0xFE41, 0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840, 0x2800, 0xE8C1,
+        0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41, 0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+        0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640, 0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0,
+        0x2080, 0xE041, 0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240, 0x6600, 0xA6C1, 0xA781, 0x6740,
+        0xA501, 0x65C0, 0x6480, 0xA441, 0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41, 0xAA01, 0x6AC0,
+        0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840, 0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+        0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40, 0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1,
+        0xB681, 0x7640, 0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041, 0x5000, 0x90C1, 0x9181, 0x5140,
+        0x9301, 0x53C0, 0x5280, 0x9241, 0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440, 0x9C01, 0x5CC0,
+        0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40, 0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+        0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40, 0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0,
+        0x4C80, 0x8C41, 0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641, 0x8201, 0x42C0, 0x4380, 0x8341,
+        0x4100, 0x81C1, 0x8081, 0x4040,
+    },
+    {
+        0x0000, 0x9001, 0x6001, 0xF000, 0xC002, 0x5003, 0xA003, 0x3002, 0xC007, 0x5006, 0xA006, 0x3007, 0x0005, 0x9004,
+        0x6004, 0xF005, 0xC00D, 0x500C, 0xA00C, 0x300D, 0x000F, 0x900E, 0x600E, 0xF00F, 0x000A, 0x900B, 0x600B, 0xF00A,
+        0xC008, 0x5009, 0xA009, 0x3008, 0xC019, 0x5018, 0xA018, 0x3019, 0x001B, 0x901A, 0x601A, 0xF01B, 0x001E, 0x901F,
+        0x601F, 0xF01E, 0xC01C, 0x501D, 0xA01D, 0x301C, 0x0014, 0x9015, 0x6015, 0xF014, 0xC016, 0x5017, 0xA017, 0x3016,
+        0xC013, 0x5012, 0xA012, 0x3013, 0x0011, 0x9010, 0x6010, 0xF011, 0xC031, 0x5030, 0xA030, 0x3031, 0x0033, 0x9032,
+        0x6032, 0xF033, 0x0036, 0x9037, 0x6037, 0xF036, 0xC034, 0x5035, 0xA035, 0x3034, 0x003C, 0x903D, 0x603D, 0xF03C,
+        0xC03E, 0x503F, 0xA03F, 0x303E, 0xC03B, 0x503A, 0xA03A, 0x303B, 0x0039, 0x9038, 0x6038, 0xF039, 0x0028, 0x9029,
+        0x6029, 0xF028, 0xC02A, 0x502B, 0xA02B, 0x302A, 0xC02F, 0x502E, 0xA02E, 0x302F, 0x002D, 0x902C, 0x602C, 0xF02D,
+        0xC025, 0x5024, 0xA024, 0x3025, 0x0027, 0x9026, 0x6026, 0xF027, 0x0022, 0x9023, 0x6023, 0xF022, 0xC020, 0x5021,
+        0xA021, 0x3020, 0xC061, 0x5060, 0xA060, 0x3061, 0x0063, 0x9062, 0x6062, 0xF063, 0x0066, 0x9067, 0x6067, 0xF066,
+        0xC064, 0x5065, 0xA065, 0x3064, 0x006C, 0x906D, 0x606D, 0xF06C, 0xC06E, 0x506F, 0xA06F, 0x306E, 0xC06B, 0x506A,
+        0xA06A, 0x306B, 0x0069, 0x9068, 0x6068, 0xF069, 0x0078, 0x9079, 0x6079, 0xF078, 0xC07A, 0x507B, 0xA07B, 0x307A,
+        0xC07F, 0x507E, 0xA07E, 0x307F, 0x007D, 0x907C, 0x607C, 0xF07D, 0xC075, 0x5074, 0xA074, 0x3075, 0x0077, 0x9076,
+        0x6076, 0xF077, 0x0072, 0x9073, 0x6073, 0xF072, 0xC070, 0x5071, 0xA071, 0x3070, 0x0050, 0x9051, 0x6051, 0xF050,
+        0xC052, 0x5053, 0xA053, 0x3052, 0xC057, 0x5056, 0xA056, 0x3057, 0x0055, 0x9054, 0x6054, 0xF055, 0xC05D, 0x505C,
+        0xA05C, 0x305D, 0x005F, 0x905E, 0x605E, 0xF05F, 0x005A, 0x905B, 0x605B, 0xF05A, 0xC058, 0x5059, 0xA059, 0x3058,
+        0xC049, 0x5048, 0xA048, 0x3049, 0x004B, 0x904A, 0x604A, 0xF04B, 0x004E, 0x904F, 0x604F, 0xF04E, 0xC04C, 0x504D,
+        0xA04D, 0x304C, 0x0044, 0x9045, 0x6045, 0xF044, 0xC046, 0x5047, 0xA047, 0x3046, 0xC043, 0x5042, 0xA042, 0x3043,
+        0x0041, 0x9040, 0x6040, 0xF041,
+    },
+    {
+        0x0000, 0xC051, 0xC0A1, 0x00F0, 0xC141, 0x0110, 0x01E0, 0xC1B1, 0xC281, 0x02D0, 0x0220, 0xC271, 0x03C0, 0xC391,
+        0xC361, 0x0330, 0xC501, 0x0550, 0x05A0, 0xC5F1, 0x0440, 0xC411, 0xC4E1, 0x04B0, 0x0780, 0xC7D1, 0xC721, 0x0770,
+        0xC6C1, 0x0690, 0x0660, 0xC631, 0xCA01, 0x0A50, 0x0AA0, 0xCAF1, 0x0B40, 0xCB11, 0xCBE1, 0x0BB0, 0x0880, 0xC8D1,
+        0xC821, 0x0870, 0xC9C1, 0x0990, 0x0960, 0xC931, 0x0F00, 0xCF51, 0xCFA1, 0x0FF0, 0xCE41, 0x0E10, 0x0EE0, 0xCEB1,
+        0xCD81, 0x0DD0, 0x0D20, 0xCD71, 0x0CC0, 0xCC91, 0xCC61, 0x0C30, 0xD401, 0x1450, 0x14A0, 0xD4F1, 0x1540, 0xD511,
+        0xD5E1, 0x15B0, 0x1680, 0xD6D1, 0xD621, 0x1670, 0xD7C1, 0x1790, 0x1760, 0xD731, 0x1100, 0xD151, 0xD1A1, 0x11F0,
+        0xD041, 0x1010, 0x10E0, 0xD0B1, 0xD381, 0x13D0, 0x1320, 0xD371, 0x12C0, 0xD291, 0xD261, 0x1230, 0x1E00, 0xDE51,
+        0xDEA1, 0x1EF0, 0xDF41, 0x1F10, 0x1FE0, 0xDFB1, 0xDC81, 0x1CD0, 0x1C20, 0xDC71, 0x1DC0, 0xDD91, 0xDD61, 0x1D30,
+        0xDB01, 0x1B50, 0x1BA0, 0xDBF1, 0x1A40, 0xDA11, 0xDAE1, 0x1AB0, 0x1980, 0xD9D1, 0xD921, 0x1970, 0xD8C1, 0x1890,
+        0x1860, 0xD831, 0xE801, 0x2850, 0x28A0, 0xE8F1, 0x2940, 0xE911, 0xE9E1, 0x29B0, 0x2A80, 0xEAD1, 0xEA21, 0x2A70,
+        0xEBC1, 0x2B90, 0x2B60, 0xEB31, 0x2D00, 0xED51, 0xEDA1, 0x2DF0, 0xEC41, 0x2C10, 0x2CE0, 0xECB1, 0xEF81, 0x2FD0,
+        0x2F20, 0xEF71, 0x2EC0, 0xEE91, 0xEE61, 0x2E30, 0x2200, 0xE251, 0xE2A1, 0x22F0, 0xE341, 0x2310, 0x23E0, 0xE3B1,
+        0xE081, 0x20D0, 0x2020, 0xE071, 0x21C0, 0xE191, 0xE161, 0x2130, 0xE701, 0x2750, 0x27A0, 0xE7F1, 0x2640, 0xE611,
+        0xE6E1, 0x26B0, 0x2580, 0xE5D1, 0xE521, 0x2570, 0xE4C1, 0x2490, 0x2460, 0xE431, 0x3C00, 0xFC51, 0xFCA1, 0x3CF0,
+        0xFD41, 0x3D10, 0x3DE0, 0xFDB1, 0xFE81, 0x3ED0, 0x3E20, 0xFE71, 0x3FC0, 0xFF91, 0xFF61, 0x3F30, 0xF901, 0x3950,
+        0x39A0, 0xF9F1, 0x3840, 0xF811, 0xF8E1, 0x38B0, 0x3B80, 0xFBD1, 0xFB21, 0x3B70, 0xFAC1, 0x3A90, 0x3A60, 0xFA31,
+        0xF601, 0x3650, 0x36A0, 0xF6F1, 0x3740, 0xF711, 0xF7E1, 0x37B0, 0x3480, 0xF4D1, 0xF421, 0x3470, 0xF5C1, 0x3590,
+        0x3560, 0xF531, 0x3300, 0xF351, 0xF3A1, 0x33F0, 0xF241, 0x3210, 0x32E0, 0xF2B1, 0xF181, 0x31D0, 0x3120, 0xF171,
+        0x30C0, 0xF091, 0xF061, 0x3030,
+    },
+    {
+        0x0000, 0xFC01, 0xB801, 0x4400, 0x3001, 0xCC00, 0x8800, 0x7401, 0x6002, 0x9C03, 0xD803, 0x2402, 0x5003, 0xAC02,
+        0xE802, 0x1403, 0xC004, 0x3C05, 0x7805, 0x8404, 0xF005, 0x0C04, 0x4804, 0xB405, 0xA006, 0x5C07, 0x1807, 0xE406,
+        0x9007, 0x6C06, 0x2806, 0xD407, 0xC00B, 0x3C0A, 0x780A, 0x840B, 0xF00A, 0x0C0B, 0x480B, 0xB40A, 0xA009, 0x5C08,
+        0x1808, 0xE409, 0x9008, 0x6C09, 0x2809, 0xD408, 0x000F, 0xFC0E, 0xB80E, 0x440F, 0x300E, 0xCC0F, 0x880F, 0x740E,
+        0x600D, 0x9C0C, 0xD80C, 0x240D, 0x500C, 0xAC0D, 0xE80D, 0x140C, 0xC015, 0x3C14, 0x7814, 0x8415, 0xF014, 0x0C15,
+        0x4815, 0xB414, 0xA017, 0x5C16, 0x1816, 0xE417, 0x9016, 0x6C17, 0x2817, 0xD416, 0x0011, 0xFC10, 0xB810, 0x4411,
+        0x3010, 0xCC11, 0x8811, 0x7410, 0x6013, 0x9C12, 0xD812, 0x2413, 0x5012, 0xAC13, 0xE813, 0x1412, 0x001E, 0xFC1F,
+        0xB81F, 0x441E, 0x301F, 0xCC1E, 0x881E, 0x741F, 0x601C, 0x9C1D, 0xD81D, 0x241C, 0x501D, 0xAC1C, 0xE81C, 0x141D,
+        0xC01A, 0x3C1B, 0x781B, 0x841A, 0xF01B, 0x0C1A, 0x481A, 0xB41B, 0xA018, 0x5C19, 0x1819, 0xE418, 0x9019, 0x6C18,
+        0x2818, 0xD419, 0xC029, 0x3C28, 0x7828, 0x8429, 0xF028, 0x0C29, 0x4829, 0xB428, 0xA02B, 0x5C2A, 0x182A, 0xE42B,
+        0x902A, 0x6C2B, 0x282B, 0xD42A, 0x002D, 0xFC2C, 0xB82C, 0x442D, 0x302C, 0xCC2D, 0x882D, 0x742C, 0x602F, 0x9C2E,
+        0xD82E, 0x242F, 0x502E, 0xAC2F, 0xE82F, 0x142E, 0x0022, 0xFC23, 0xB823, 0x4422, 0x3023, 0xCC22, 0x8822, 0x7423,
+        0x6020, 0x9C21, 0xD821, 0x2420, 0x5021, 0xAC20, 0xE820, 0x1421, 0xC026, 0x3C27, 0x7827, 0x8426, 0xF027, 0x0C26,
+        0x4826, 0xB427, 0xA024, 0x5C25, 0x1825, 0xE424, 0x9025, 0x6C24, 0x2824, 0xD425, 0x003C, 0xFC3D, 0xB83D, 0x443C,
+        0x303D, 0xCC3C, 0x883C, 0x743D, 0x603E, 0x9C3F, 0xD83F, 0x243E, 0x503F, 0xAC3E, 0xE83E, 0x143F, 0xC038, 0x3C39,
+        0x7839, 0x8438, 0xF039, 0x0C38, 0x4838, 0xB439, 0xA03A, 0x5C3B, 0x183B, 0xE43A, 0x903B, 0x6C3A, 0x283A, 0xD43B,
+        0xC037, 0x3C36, 0x7836, 0x8437, 0xF036, 0x0C37, 0x4837, 0xB436, 0xA035, 0x5C34, 0x1834, 0xE435, 0x9034, 0x6C35,
+        0x2835, 0xD434, 0x0033, 0xFC32, 0xB832, 0x4433, 0x3032, 0xCC33, 0x8833, 0x7432, 0x6031, 0x9C30, 0xD830, 0x2431,
+        0x5030, 0xAC31, 0xE831, 0x1430,
+    },
+    {
+        0x0000, 0xC03D, 0xC079, 0x0044, 0xC0F1, 0x00CC, 0x0088, 0xC0B5, 0xC1E1, 0x01DC, 0x0198, 0xC1A5, 0x0110, 0xC12D,
+        0xC169, 0x0154, 0xC3C1, 0x03FC, 0x03B8, 0xC385, 0x0330, 0xC30D, 0xC349, 0x0374, 0x0220, 0xC21D, 0xC259, 0x0264,
+        0xC2D1, 0x02EC, 0x02A8, 0xC295, 0xC781, 0x07BC, 0x07F8, 0xC7C5, 0x0770, 0xC74D, 0xC709, 0x0734, 0x0660, 0xC65D,
+        0xC619, 0x0624, 0xC691, 0x06AC, 0x06E8, 0xC6D5, 0x0440, 0xC47D, 0xC439, 0x0404, 0xC4B1, 0x048C, 0x04C8, 0xC4F5,
+        0xC5A1, 0x059C, 0x05D8, 0xC5E5, 0x0550, 0xC56D, 0xC529, 0x0514, 0xCF01, 0x0F3C, 0x0F78, 0xCF45, 0x0FF0, 0xCFCD,
+        0xCF89, 0x0FB4, 0x0EE0, 0xCEDD, 0xCE99, 0x0EA4, 0xCE11, 0x0E2C, 0x0E68, 0xCE55, 0x0CC0, 0xCCFD, 0xCCB9, 0x0C84,
+        0xCC31, 0x0C0C, 0x0C48, 0xCC75, 0xCD21, 0x0D1C, 0x0D58, 0xCD65, 0x0DD0, 0xCDED, 0xCDA9, 0x0D94, 0x0880, 0xC8BD,
+        0xC8F9, 0x08C4, 0xC871, 0x084C, 0x0808, 0xC835, 0xC961, 0x095C, 0x0918, 0xC925, 0x0990, 0xC9AD, 0xC9E9, 0x09D4,
+        0xCB41, 0x0B7C, 0x0B38, 0xCB05, 0x0BB0, 0xCB8D, 0xCBC9, 0x0BF4, 0x0AA0, 0xCA9D, 0xCAD9, 0x0AE4, 0xCA51, 0x0A6C,
+        0x0A28, 0xCA15, 0xDE01, 0x1E3C, 0x1E78, 0xDE45, 0x1EF0, 0xDECD, 0xDE89, 0x1EB4, 0x1FE0, 0xDFDD, 0xDF99, 0x1FA4,
+        0xDF11, 0x1F2C, 0x1F68, 0xDF55, 0x1DC0, 0xDDFD, 0xDDB9, 0x1D84, 0xDD31, 0x1D0C, 0x1D48, 0xDD75, 0xDC21, 0x1C1C,
+        0x1C58, 0xDC65, 0x1CD0, 0xDCED, 0xDCA9, 0x1C94, 0x1980, 0xD9BD, 0xD9F9, 0x19C4, 0xD971, 0x194C, 0x1908, 0xD935,
+        0xD861, 0x185C, 0x1818, 0xD825, 0x1890, 0xD8AD, 0xD8E9, 0x18D4, 0xDA41, 0x1A7C, 0x1A38, 0xDA05, 0x1AB0, 0xDA8D,
+        0xDAC9, 0x1AF4, 0x1BA0, 0xDB9D, 0xDBD9, 0x1BE4, 0xDB51, 0x1B6C, 0x1B28, 0xDB15, 0x1100, 0xD13D, 0xD179, 0x1144,
+        0xD1F1, 0x11CC, 0x1188, 0xD1B5, 0xD0E1, 0x10DC, 0x1098, 0xD0A5, 0x1010, 0xD02D, 0xD069, 0x1054, 0xD2C1, 0x12FC,
+        0x12B8, 0xD285, 0x1230, 0xD20D, 0xD249, 0x1274, 0x1320, 0xD31D, 0xD359, 0x1364, 0xD3D1, 0x13EC, 0x13A8, 0xD395,
+        0xD681, 0x16BC, 0x16F8, 0xD6C5, 0x1670, 0xD64D, 0xD609, 0x1634, 0x1760, 0xD75D, 0xD719, 0x1724, 0xD791, 0x17AC,
+        0x17E8, 0xD7D5, 0x1540, 0xD57D, 0xD539, 0x1504, 0xD5B1, 0x158C, 0x15C8, 0xD5F5, 0xD4A1, 0x149C, 0x14D8, 0xD4E5,
+        0x1450, 0xD46D, 0xD429, 0x1414,
+    },
+    {
+        0x0000, 0xD101, 0xE201, 0x3300, 0x8401, 0x5500, 0x6600, 0xB701, 0x4801, 0x9900, 0xAA00, 0x7B01, 0xCC00, 0x1D01,
+        0x2E01, 0xFF00, 0x9002, 0x4103, 0x7203, 0xA302, 0x1403, 0xC502, 0xF602, 0x2703, 0xD803, 0x0902, 0x3A02, 0xEB03,
+        0x5C02, 0x8D03, 0xBE03, 0x6F02, 0x6007, 0xB106, 0x8206, 0x5307, 0xE406, 0x3507, 0x0607, 0xD706, 0x2806, 0xF907,
+        0xCA07, 0x1B06, 0xAC07, 0x7D06, 0x4E06, 0x9F07, 0xF005, 0x2104, 0x1204, 0xC305, 0x7404, 0xA505, 0x9605, 0x4704,
+        0xB804, 0x6905, 0x5A05, 0x8B04, 0x3C05, 0xED04, 0xDE04, 0x0F05, 0xC00E, 0x110F, 0x220F, 0xF30E, 0x440F, 0x950E,
+        0xA60E, 0x770F, 0x880F, 0x590E, 0x6A0E, 0xBB0F, 0x0C0E, 0xDD0F, 0xEE0F, 0x3F0E, 0x500C, 0x810D, 0xB20D, 0x630C,
+        0xD40D, 0x050C, 0x360C, 0xE70D, 0x180D, 0xC90C, 0xFA0C, 0x2B0D, 0x9C0C, 0x4D0D, 0x7E0D, 0xAF0C, 0xA009, 0x7108,
+        0x4208, 0x9309, 0x2408, 0xF509, 0xC609, 0x1708, 0xE808, 0x3909, 0x0A09, 0xDB08, 0x6C09, 0xBD08, 0x8E08, 0x5F09,
+        0x300B, 0xE10A, 0xD20A, 0x030B, 0xB40A, 0x650B, 0x560B, 0x870A, 0x780A, 0xA90B, 0x9A0B, 0x4B0A, 0xFC0B, 0x2D0A,
+        0x1E0A, 0xCF0B, 0xC01F, 0x111E, 0x221E, 0xF31F, 0x441E, 0x951F, 0xA61F, 0x771E, 0x881E, 0x591F, 0x6A1F, 0xBB1E,
+        0x0C1F, 0xDD1E, 0xEE1E, 0x3F1F, 0x501D, 0x811C, 0xB21C, 0x631D, 0xD41C, 0x051D, 0x361D, 0xE71C, 0x181C, 0xC91D,
+        0xFA1D, 0x2B1C, 0x9C1D, 0x4D1C, 0x7E1C, 0xAF1D, 0xA018, 0x7119, 0x4219, 0x9318, 0x2419, 0xF518, 0xC618, 0x1719,
+        0xE819, 0x3918, 0x0A18, 0xDB19, 0x6C18, 0xBD19, 0x8E19, 0x5F18, 0x301A, 0xE11B, 0xD21B, 0x031A, 0xB41B, 0x651A,
+        0x561A, 0x871B, 0x781B, 0xA91A, 0x9A1A, 0x4B1B, 0xFC1A, 0x2D1B, 0x1E1B, 0xCF1A, 0x0011, 0xD110, 0xE210, 0x3311,
+        0x8410, 0x5511, 0x6611, 0xB710, 0x4810, 0x9911, 0xAA11, 0x7B10, 0xCC11, 0x1D10, 0x2E10, 0xFF11, 0x9013, 0x4112,
+        0x7212, 0xA313, 0x1412, 0xC513, 0xF613, 0x2712, 0xD812, 0x0913, 0x3A13, 0xEB12, 0x5C13, 0x8D12, 0xBE12, 0x6F13,
+        0x6016, 0xB117, 0x8217, 0x5316, 0xE417, 0x3516, 0x0616, 0xD717, 0x2817, 0xF916, 0xCA16, 0x1B17, 0xAC16, 0x7D17,
+        0x4E17, 0x9F16, 0xF014, 0x2115, 0x1215, 0xC314, 0x7415, 0xA514, 0x9614, 0x4715, 0xB815, 0x6914, 0x5A14, 0x8B15,
+        0x3C14, 0xED15, 0xDE15, 0x0F14,
+    },
+    {
+        0x0000, 0xC010, 0xC023, 0x0033, 0xC045, 0x0055, 0x0066, 0xC076, 0xC089, 0x0099, 0x00AA, 0xC0BA, 0x00CC, 0xC0DC,
+        0xC0EF, 0x00FF, 0xC111, 0x0101, 0x0132, 0xC122, 0x0154, 0xC144, 0xC177, 0x0167, 0x0198, 0xC188, 0xC1BB, 0x01AB,
+        0xC1DD, 0x01CD, 0x01FE, 0xC1EE, 0xC221, 0x0231, 0x0202, 0xC212, 0x0264, 0xC274, 0xC247, 0x0257, 0x02A8, 0xC2B8,
+        0xC28B, 0x029B, 0xC2ED, 0x02FD, 0x02CE, 0xC2DE, 0x0330, 0xC320, 0xC313, 0x0303, 0xC375, 0x0365, 0x0356, 0xC346,
+        0xC3B9, 0x03A9, 0x039A, 0xC38A, 0x03FC, 0xC3EC, 0xC3DF, 0x03CF, 0xC441, 0x0451, 0x0462, 0xC472, 0x0404, 0xC414,
+        0xC427, 0x0437, 0x04C8, 0xC4D8, 0xC4EB, 0x04FB, 0xC48D, 0x049D, 0x04AE, 0xC4BE, 0x0550, 0xC540, 0xC573, 0x0563,
+        0xC515, 0x0505, 0x0536, 0xC526, 0xC5D9, 0x05C9, 0x05FA, 0xC5EA, 0x059C, 0xC58C, 0xC5BF, 0x05AF, 0x0660, 0xC670,
+        0xC643, 0x0653, 0xC625, 0x0635, 0x0606, 0xC616, 0xC6E9, 0x06F9, 0x06CA, 0xC6DA, 0x06AC, 0xC6BC, 0xC68F, 0x069F,
+        0xC771, 0x0761, 0x0752, 0xC742, 0x0734, 0xC724, 0xC717, 0x0707, 0x07F8, 0xC7E8, 0xC7DB, 0x07CB, 0xC7BD, 0x07AD,
+        0x079E, 0xC78E, 0xC881, 0x0891, 0x08A2, 0xC8B2, 0x08C4, 0xC8D4, 0xC8E7, 0x08F7, 0x0808, 0xC818, 0xC82B, 0x083B,
+        0xC84D, 0x085D, 0x086E, 0xC87E, 0x0990, 0xC980, 0xC9B3, 0x09A3, 0xC9D5, 0x09C5, 0x09F6, 0xC9E6, 0xC919, 0x0909,
+        0x093A, 0xC92A, 0x095C, 0xC94C, 0xC97F, 0x096F, 0x0AA0, 0xCAB0, 0xCA83, 0x0A93, 0xCAE5, 0x0AF5, 0x0AC6, 0xCAD6,
+        0xCA29, 0x0A39, 0x0A0A, 0xCA1A, 0x0A6C, 0xCA7C, 0xCA4F, 0x0A5F, 0xCBB1, 0x0BA1, 0x0B92, 0xCB82, 0x0BF4, 0xCBE4,
+        0xCBD7, 0x0BC7, 0x0B38, 0xCB28, 0xCB1B, 0x0B0B, 0xCB7D, 0x0B6D, 0x0B5E, 0xCB4E, 0x0CC0, 0xCCD0, 0xCCE3, 0x0CF3,
+        0xCC85, 0x0C95, 0x0CA6, 0xCCB6, 0xCC49, 0x0C59, 0x0C6A, 0xCC7A, 0x0C0C, 0xCC1C, 0xCC2F, 0x0C3F, 0xCDD1, 0x0DC1,
+        0x0DF2, 0xCDE2, 0x0D94, 0xCD84, 0xCDB7, 0x0DA7, 0x0D58, 0xCD48, 0xCD7B, 0x0D6B, 0xCD1D, 0x0D0D, 0x0D3E, 0xCD2E,
+        0xCEE1, 0x0EF1, 0x0EC2, 0xCED2, 0x0EA4, 0xCEB4, 0xCE87, 0x0E97, 0x0E68, 0xCE78, 0xCE4B, 0x0E5B, 0xCE2D, 0x0E3D,
+        0x0E0E, 0xCE1E, 0x0FF0, 0xCFE0, 0xCFD3, 0x0FC3, 0xCFB5, 0x0FA5, 0x0F96, 0xCF86, 0xCF79, 0x0F69, 0x0F5A, 0xCF4A,
+        0x0F3C, 0xCF2C, 0xCF1F, 0x0F0F,
+    },
+    {
+        0x0000, 0xCCC1, 0xD981, 0x1540, 0xF301, 0x3FC0, 0x2A80, 0xE641, 0xA601, 0x6AC0, 0x7F80, 0xB341, 0x5500, 0x99C1,
+        0x8C81, 0x4040, 0x0C01, 0xC0C0, 0xD580, 0x1941, 0xFF00, 0x33C1, 0x2681, 0xEA40, 0xAA00, 0x66C1, 0x7381, 0xBF40,
+        0x5901, 0x95C0, 0x8080, 0x4C41, 0x1802, 0xD4C3, 0xC183, 0x0D42, 0xEB03, 0x27C2, 0x3282, 0xFE43, 0xBE03, 0x72C2,
+        0x6782, 0xAB43, 0x4D02, 0x81C3, 0x9483, 0x5842, 0x1403, 0xD8C2, 0xCD82, 0x0143, 0xE702, 0x2BC3, 0x3E83, 0xF242,
+        0xB202, 0x7EC3, 0x6B83, 0xA742, 0x4103, 0x8DC2, 0x9882, 0x5443, 0x3004, 0xFCC5, 0xE985, 0x2544, 0xC305, 0x0FC4,
+        0x1A84, 0xD645, 0x9605, 0x5AC4, 0x4F84, 0x8345, 0x6504, 0xA9C5, 0xBC85, 0x7044, 0x3C05, 0xF0C4, 0xE584, 0x2945,
+        0xCF04, 0x03C5, 0x1685, 0xDA44, 0x9A04, 0x56C5, 0x4385, 0x8F44, 0x6905, 0xA5C4, 0xB084, 0x7C45, 0x2806, 0xE4C7,
+        0xF187, 0x3D46, 0xDB07, 0x17C6, 0x0286, 0xCE47, 0x8E07, 0x42C6, 0x5786, 0x9B47, 0x7D06, 0xB1C7, 0xA487, 0x6846,
+        0x2407, 0xE8C6, 0xFD86, 0x3147, 0xD706, 0x1BC7, 0x0E87, 0xC246, 0x8206, 0x4EC7, 0x5B87, 0x9746, 0x7107, 0xBDC6,
+        0xA886, 0x6447, 0x6008, 0xACC9, 0xB989, 0x7548, 0x9309, 0x5FC8, 0x4A88, 0x8649, 0xC609, 0x0AC8, 0x1F88, 0xD349,
+        0x3508, 0xF9C9, 0xEC89, 0x2048, 0x6C09, 0xA0C8, 0xB588, 0x7949, 0x9F08, 0x53C9, 0x4689, 0x8A48, 0xCA08, 0x06C9,
+        0x1389, 0xDF48, 0x3909, 0xF5C8, 0xE088, 0x2C49, 0x780A, 0xB4CB, 0xA18B, 0x6D4A, 0x8B0B, 0x47CA, 0x528A, 0x9E4B,
+        0xDE0B, 0x12CA, 0x078A, 0xCB4B, 0x2D0A, 0xE1CB, 0xF48B, 0x384A, 0x740B, 0xB8CA, 0xAD8A, 0x614B, 0x870A, 0x4BCB,
+        0x5E8B, 0x924A, 0xD20A, 0x1ECB, 0x0B8B, 0xC74A, 0x210B, 0xEDCA, 0xF88A, 0x344B, 0x500C, 0x9CCD, 0x898D, 0x454C,
+        0xA30D, 0x6FCC, 0x7A8C, 0xB64D, 0xF60D, 0x3ACC, 0x2F8C, 0xE34D, 0x050C, 0xC9CD, 0xDC8D, 0x104C, 0x5C0D, 0x90CC,
+        0x858C, 0x494D, 0xAF0C, 0x63CD, 0x768D, 0xBA4C, 0xFA0C, 0x36CD, 0x238D, 0xEF4C, 0x090D, 0xC5CC, 0xD08C, 0x1C4D,
+        0x480E, 0x84CF, 0x918F, 0x5D4E, 0xBB0F, 0x77CE, 0x628E, 0xAE4F, 0xEE0F, 0x22CE, 0x378E, 0xFB4F, 0x1D0E, 0xD1CF,
+        0xC48F, 0x084E, 0x440F, 0x88CE, 0x9D8E, 0x514F, 0xB70E, 0x7BCF, 0x6E8F, 0xA24E, 0xE20E, 0x2ECF, 0x3B8F, 0xF74E,
+        0x110F, 0xDDCE, 0xC88E, 0x044F,
+    },
+};
 
-static uint16_t MiniModbus_Crc16Table[] = {
+#define MiniModbus_Crc16Table MiniModbus_Crc16SlicingTable[0]
+#else
+static const uint16_t MiniModbus_Crc16Table[] = {
     0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241, 0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1,
     0xC481, 0x0440, 0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40, 0x0A00, 0xCAC1, 0xCB81, 0x0B40,
     0xC901, 0x09C0, 0x0880, 0xC841, 0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40, 0x1E00, 0xDEC1,
@@ -54,11 +260,10 @@ static uint16_t MiniModbus_Crc16Table[] = {
     0x4C80, 0x8C41, 0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641, 0x8201, 0x42C0, 0x4380, 0x8341,
     0x4100, 0x81C1, 0x8081, 0x4040,
 };
+#endif /* MINI_MODBUS_FAST_CRC */
 
-static uint16_t MiniModbus_Crc16(uint8_t *data, size_t length)
+static uint16_t MiniModbus_Crc16TableUpdate(uint16_t crc, const uint8_t *data, size_t length)
 {
-    uint16_t crc = 0xFFFF;
-
     while (length-- > 0) {
         crc = (crc >> 8) ^ MiniModbus_Crc16Table[(crc ^ *data++) & 0xFF];
     }
@@ -66,6 +271,286 @@ static uint16_t MiniModbus_Crc16(uint8_t *data, size_t length)
     return crc;
 }
 
+#ifdef MINI_MODBUS_FAST_CRC
+static uint16_t MiniModbus_Crc16SlicingUpdate(uint16_t crc, const uint8_t *data, size_t length)
+{
+    const uint16_t(*table)[256] = MiniModbus_Crc16SlicingTable;
+
+    while (length >= 8) {
+        crc = table[7][(crc ^ data[0]) & 0xFF] ^ table[6][((crc >> 8) ^ data[1]) & 0xFF] ^ table[5][data[2]] ^
+              table[4][data[3]] ^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+        data += 8;
+        length -= 8;
+    }
+
+    return MiniModbus_Crc16TableUpdate(crc, data, length);
+}
+#endif /* MINI_MODBUS_FAST_CRC */
+
+#ifdef MINI_MODBUS_HAVE_CLMUL
+/*
+ * Bit reflected constants for the carry-less multiplication: floor(x^80 / P) without the x^64 term for the Barrett
+ * reduction, the polynomial P = x^16 + x^15 + x^2 + 1 itself, and x^191 mod P, x^127 mod P to fold 16 bytes forward.
+ */
+#define CRC16_CLMUL_MU 0xF87FF5FFE7FFDFFFULL
+#define CRC16_CLMUL_POLY 0x14003ULL
+#define CRC16_CLMUL_FOLD_HIGH 0xCCD0000000000000ULL
+#define CRC16_CLMUL_FOLD_LOW 0xC100000000000000ULL
+
+/*
+ * Barrett reduction of a 64 bit block (already xored with the current CRC): a carry-less multiplication by the
+ * constant gives the quotient, and another by the polynomial the remainder.
+ */
+__attribute__((target("pclmul,sse2"))) static uint16_t MiniModbus_Crc16ClmulBlock(uint64_t block)
+{
+    const __m128i mu = _mm_cvtsi64_si128((long long)CRC16_CLMUL_MU);
+    const __m128i poly = _mm_cvtsi64_si128((long long)CRC16_CLMUL_POLY);
+
+    uint64_t product = (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)block), mu, 0));
+    uint64_t quotient = (block ^ (product << 1)) >> 48;
+    product = (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_cvtsi64_si128((long long)quotient), poly, 0));
+
+    return (product >> 16) & 0xFFFF;
+}
+
+/*
+ * Buffers of at least 32 bytes are folded 16 bytes at a time into a 128 bit remainder, with two independent
+ * multiplications per step, and the remainder is then reduced with two Barrett steps. Shorter buffers and the tail
+ * go through the Barrett reduction 8 bytes at a time.
+ */
+__attribute__((target("pclmul,sse2"))) static uint16_t MiniModbus_Crc16ClmulUpdate(uint16_t crc, const uint8_t *data,
+                                                                                  size_t length)
+{
+    uint64_t block;
+
+    if (length >= 32) {
+        const __m128i fold = _mm_set_epi64x((long long)CRC16_CLMUL_FOLD_LOW, (long long)CRC16_CLMUL_FOLD_HIGH);
+        __m128i remainder = _mm_xor_si128(_mm_loadu_si128((const __m128i *)data), _mm_cvtsi32_si128(crc));
+        data += 16;
+        length -= 16;
+
+        while (length >= 16) {
+            remainder = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(remainder, fold, 0x00),
+                                                    _mm_clmulepi64_si128(remainder, fold, 0x11)),
+                                      _mm_loadu_si128((const __m128i *)data));
+            data += 16;
+            length -= 16;
+        }
+
+        crc = MiniModbus_Crc16ClmulBlock((uint64_t)_mm_cvtsi128_si64(remainder));
+        crc = MiniModbus_Crc16ClmulBlock((uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(remainder, remainder)) ^ crc);
+    }
+
+    while (length >= 8) {
+        memcpy(&block, data, sizeof(block)); // x86 is little endian, as the bit reflected CRC
+        crc = MiniModbus_Crc16ClmulBlock(block ^ crc);
+        data += 8;
+        length -= 8;
+    }
+
+    return MiniModbus_Crc16TableUpdate(crc, data, length);
+}
+
+static int MiniModbus_Crc16ClmulSupported(void)
+{
+    // contexts on other threads may race to fill the cache, they all store the same value
+    static int supported = -1;
+
+    int result = __atomic_load_n(&supported, __ATOMIC_RELAXED);
+    if (result < 0) {
+        result = __builtin_cpu_supports("pclmul") ? 1 : 0;
+        __atomic_store_n(&supported, result, __ATOMIC_RELAXED);
+    }
+
+    return result;
+}
+#endif /* MINI_MODBUS_HAVE_CLMUL */
+
+uint16_t MiniModbus_Crc16(const void *data, size_t length)
+{
+#if defined(MINI_MODBUS_HAVE_CLMUL)
+    if (MiniModbus_Crc16ClmulSupported()) {
+        return MiniModbus_Crc16ClmulUpdate(0xFFFF, data, length);
+    }
+    return MiniModbus_Crc16SlicingUpdate(0xFFFF, data, length);
+#elif defined(MINI_MODBUS_FAST_CRC)
+    return MiniModbus_Crc16SlicingUpdate(0xFFFF, data, length);
+#else
+    return MiniModbus_Crc16TableUpdate(0xFFFF, data, length);
+#endif
+}
+
+MiniModbusError_t MiniModbus_Crc16Implementation(MiniModbusCrc_t implementation, const void *data, size_t length,
+                                                 uint16_t *crc)
+{
+    if ((data == NULL && length > 0) || crc == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    switch (implementation) {
+    case MiniModbusCrc_Table:
+        *crc = MiniModbus_Crc16TableUpdate(0xFFFF, data, length);
+        return MiniModbusError_Success;
+#ifdef MINI_MODBUS_FAST_CRC
+    case MiniModbusCrc_Slicing8:
+        *crc = MiniModbus_Crc16SlicingUpdate(0xFFFF, data, length);
+        return MiniModbusError_Success;
+#endif /* MINI_MODBUS_FAST_CRC */
+#ifdef MINI_MODBUS_HAVE_CLMUL
+    case MiniModbusCrc_Clmul:
+        if (!MiniModbus_Crc16ClmulSupported()) {
+            return MiniModbusError_InvalidArgument;
+        }
+        *crc = MiniModbus_Crc16ClmulUpdate(0xFFFF, data, length);
+        return MiniModbusError_Success;
+#endif /* MINI_MODBUS_HAVE_CLMUL */
+    default:
+        return MiniModbusError_InvalidArgument;
+    }
+}
+
+static uint32_t MiniModbus_Now(const MiniModbusContext_t *ctx)
+{
+    return ctx->config.clock != NULL ? ctx->config.clock(ctx->config.user_data) : 0;
+}
+
+#ifdef MINI_MODBUS_STATS
+
+// which latency histograms a completed transaction updates
+#define STATS_TIMING_NONE 0
+#define STATS_TIMING_TOTAL 1
+#define STATS_TIMING_FULL 2
+
+#define MINI_MODBUS_STATS_SEND(ctx, data, length) MiniModbus_StatsSend(ctx, data, length)
+#define MINI_MODBUS_STATS_SENT(ctx) MiniModbus_StatsSent(ctx)
+#define MINI_MODBUS_STATS_RECEIVED(ctx, data, length, result) MiniModbus_StatsReceived(ctx, data, length, result)
+#define MINI_MODBUS_STATS_COMPLETE(ctx, function_code, result, timing)                                                 \
+    MiniModbus_StatsComplete(ctx, function_code, result, timing)
+
+static void MiniModbus_StatsRecord(uint32_t *histogram, uint32_t elapsed)
+{
+    size_t bucket = 0;
+    while (elapsed != 0 && bucket < MINI_MODBUS_STATS_BUCKETS - 1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+
+    histogram[bucket]++;
+}
+
+static void MiniModbus_StatsSend(MiniModbusContext_t *ctx, const uint8_t *data, size_t length)
+{
+    ctx->stats.requests[ctx->request_code & 0x1F]++;
+    ctx->stats.bytes_sent += length;
+    if (ctx->config.trace_send != NULL) {
+        ctx->config.trace_send(ctx->config.user_data, data, length);
+    }
+    ctx->stats.time_start = MiniModbus_Now(ctx);
+}
+
+static void MiniModbus_StatsSent(MiniModbusContext_t *ctx)
+{
+    ctx->stats.time_sent = MiniModbus_Now(ctx);
+}
+
+static void MiniModbus_StatsReceived(MiniModbusContext_t *ctx, const uint8_t *data, size_t length,
+                                     MiniModbusError_t result)
+{
+    ctx->stats.time_received = MiniModbus_Now(ctx);
+    ctx->stats.bytes_received += length;
+    if (ctx->config.trace_receive != NULL) {
+        ctx->config.trace_receive(ctx->config.user_data, data, length, result);
+    }
+}
+
+static void MiniModbus_StatsComplete(MiniModbusContext_t *ctx, uint8_t function_code, MiniModbusError_t result,
+                                     int timing)
+{
+    MiniModbusStats_t *stats = &ctx->stats;
+
+    if (result == MiniModbusError_Success) {
+        stats->responses[function_code & 0x1F]++;
+    } else if (result < 0) {
+        stats->errors[-result < MINI_MODBUS_ERROR_COUNT ? -result : 0]++;
+    } else {
+        stats->exceptions[result < 16 ? result : 0]++;
+    }
+
+    // timeouts and garbled responses would only blur the latency of the device
+    if (result < 0 || timing == STATS_TIMING_NONE || ctx->config.clock == NULL) {
+        return;
+    }
+
+    uint32_t now = MiniModbus_Now(ctx);
+    MiniModbus_StatsRecord(stats->transaction_time, now - stats->time_start);
+    if (timing == STATS_TIMING_FULL) {
+        MiniModbus_StatsRecord(stats->send_time, stats->time_sent - stats->time_start);
+        MiniModbus_StatsRecord(stats->wait_time, stats->time_received - stats->time_sent);
+        MiniModbus_StatsRecord(stats->decode_time, now - stats->time_received);
+    }
+}
+
+const MiniModbusStats_t *MiniModbus_StatsGet(const MiniModbusContext_t *ctx)
+{
+    return ctx != NULL ? &ctx->stats : NULL;
+}
+
+void MiniModbus_StatsReset(MiniModbusContext_t *ctx)
+{
+    if (ctx != NULL) {
+        memset(&ctx->stats, 0, sizeof(MiniModbusStats_t));
+    }
+}
+
+uint32_t MiniModbus_StatsPercentile(const uint32_t *histogram, unsigned percent)
+{
+    if (histogram == NULL) {
+        return 0;
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < MINI_MODBUS_STATS_BUCKETS; i++) {
+        total += histogram[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    // rank of the sample at the percentile, rounded up, at least the first one
+    uint64_t rank = (total * (percent > 100 ? 100 : percent) + 99) / 100;
+    uint64_t count = 0;
+    size_t bucket = 0;
+    for (; bucket < MINI_MODBUS_STATS_BUCKETS - 1; bucket++) {
+        count += histogram[bucket];
+        if (count >= rank && count > 0) {
+            break;
+        }
+    }
+
+    return bucket == 0 ? 0 : (uint32_t)((1ULL << bucket) - 1);
+}
+
+#else
+
+#define MINI_MODBUS_STATS_SEND(ctx, data, length)
+#define MINI_MODBUS_STATS_SENT(ctx)
+#define MINI_MODBUS_STATS_RECEIVED(ctx, data, length, result)
+#define MINI_MODBUS_STATS_COMPLETE(ctx, function_code, result, timing) ((void)(ctx))
+
+#endif /* MINI_MODBUS_STATS */
+
+static uint16_t MiniModbus_GetUInt16(const uint8_t *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+static void MiniModbus_PutUInt16(uint8_t *data, uint16_t value)
+{
+    data[0] = (value >> 8) & 0xFF;
+    data[1] = value & 0xFF;
+}
+
 static void MiniModbus_RequestAddByte(MiniModbusContext_t *ctx, uint8_t byte)
 {
     ctx->buffer[ctx->buffer_position++] = byte;
@@ -100,7 +585,45 @@ static void MiniModbus_RequestStart(MiniModbusContext_t *ctx, uint8_t function_c
     MiniModbus_RequestAddByte(ctx, function_code);
 }
 
-static MiniModbusError_t MiniModbus_PacketSend(MiniModbusContext_t *ctx)
+static size_t MiniModbus_HeaderLength(const MiniModbusContext_t *ctx)
+{
+    return ctx->config.mode == MiniModbusMode_TCP ? MODBUS_TCP_FRAME_OVERHEAD : 1;
+}
+
+static size_t MiniModbus_FrameOverhead(const MiniModbusContext_t *ctx)
+{
+    return ctx->config.mode == MiniModbusMode_TCP ? MODBUS_TCP_FRAME_OVERHEAD : MODBUS_RTU_FRAME_OVERHEAD;
+}
+
+/*
+ * Invalidate in the attached cache the holding registers written by a request frame about to be sent. Called on
+ * every send, not when the frame is built, and even if the write then fails: the device may have executed it anyway.
+ */
+static void MiniModbus_CacheInvalidateRequest(MiniModbusContext_t *ctx, const uint8_t *frame)
+{
+    if (ctx->cache == NULL) {
+        return;
+    }
+
+    const uint8_t *pdu = frame + MiniModbus_HeaderLength(ctx);
+    switch (pdu[0]) {
+    case FUNCTION_WRITE_SINGLE_REGISTER:
+        MiniModbus_CacheInvalidate(ctx->cache, MiniModbusTable_HoldingRegisters, MiniModbus_GetUInt16(pdu + 1), 1);
+        break;
+    case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+        MiniModbus_CacheInvalidate(ctx->cache, MiniModbusTable_HoldingRegisters, MiniModbus_GetUInt16(pdu + 1),
+                                   MiniModbus_GetUInt16(pdu + 3));
+        break;
+    case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+        MiniModbus_CacheInvalidate(ctx->cache, MiniModbusTable_HoldingRegisters, MiniModbus_GetUInt16(pdu + 5),
+                                   MiniModbus_GetUInt16(pdu + 7));
+        break;
+    default:
+        break;
+    }
+}
+
+static void MiniModbus_PacketFinalize(MiniModbusContext_t *ctx)
 {
     uint16_t crc;
     uint16_t tcp_length = ctx->buffer_position - 6; // -6 to account for header size
@@ -116,8 +639,16 @@ static MiniModbusError_t MiniModbus_PacketSend(MiniModbusContext_t *ctx)
         ctx->buffer[5] = tcp_length & 0xFF;
         break;
     }
+}
+
+static MiniModbusError_t MiniModbus_PacketSend(MiniModbusContext_t *ctx)
+{
+    MiniModbus_PacketFinalize(ctx);
+    MiniModbus_CacheInvalidateRequest(ctx, ctx->buffer);
 
+    MINI_MODBUS_STATS_SEND(ctx, ctx->buffer, ctx->buffer_position);
     int sent = ctx->config.send(ctx->config.user_data, ctx->buffer, ctx->buffer_position);
+    MINI_MODBUS_STATS_SENT(ctx);
 
     if (sent < 0 || (size_t)sent != ctx->buffer_position) {
         return MiniModbusError_Send;
@@ -126,6 +657,51 @@ static MiniModbusError_t MiniModbus_PacketSend(MiniModbusContext_t *ctx)
     return MiniModbusError_Success;
 }
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+// byte i of a 64 bit word in memory is its most significant byte
+#define BITS_SPREAD_MASK 0x0102040810204080ULL
+#define BITS_GATHER_MAGIC 0x8040201008040201ULL
+#else
+#define BITS_SPREAD_MASK 0x8040201008040201ULL
+#define BITS_GATHER_MAGIC 0x0102040810204080ULL
+#endif
+
+void MiniModbus_BitsUnpack(const uint8_t *packed, size_t count, uint8_t *values)
+{
+    size_t i = 0;
+
+    // 8 bits at a time: copy the byte in all the bytes of a word, keep bit i in byte i, turn it into 0 or 1
+    for (; i + 8 <= count; i += 8) {
+        uint64_t word = (packed[i / 8] * 0x0101010101010101ULL) & BITS_SPREAD_MASK;
+        word = ((word + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+        memcpy(values + i, &word, 8);
+    }
+
+    for (; i < count; i++) {
+        values[i] = (packed[i / 8] >> (i % 8)) & 1;
+    }
+}
+
+void MiniModbus_BitsPack(const uint8_t *values, size_t count, uint8_t *packed)
+{
+    size_t i = 0;
+
+    // 8 bits at a time: turn each non zero byte into 1, then gather byte i into bit i of the top byte
+    for (; i + 8 <= count; i += 8) {
+        uint64_t word;
+        memcpy(&word, values + i, 8);
+        word = ((((word & 0x7F7F7F7F7F7F7F7FULL) + 0x7F7F7F7F7F7F7F7FULL) | word) >> 7) & 0x0101010101010101ULL;
+        packed[i / 8] = (uint8_t)((word * BITS_GATHER_MAGIC) >> 56);
+    }
+
+    if (i < count) {
+        packed[i / 8] = 0;
+    }
+    for (; i < count; i++) {
+        packed[i / 8] |= (values[i] != 0) << (i % 8);
+    }
+}
+
 static uint8_t MiniModbus_ResponseReadByte(MiniModbusContext_t *ctx)
 {
     return ctx->buffer[ctx->buffer_position++];
@@ -140,31 +716,12 @@ static uint16_t MiniModbus_ResponseReadUIn16(MiniModbusContext_t *ctx)
     return value;
 }
 
-static MiniModbusError_t MiniModbus_SendRequestAndWaitResponse(MiniModbusContext_t *ctx)
+/*
+ * Validate a full response frame of total_received bytes stored in the context buffer.
+ * On success the buffer position is left on the first byte after the function code.
+ */
+static MiniModbusError_t MiniModbus_ResponseValidate(MiniModbusContext_t *ctx, size_t total_received)
 {
-    MiniModbusError_t error = MiniModbus_PacketSend(ctx);
-    if (error != MiniModbusError_Success) {
-        return error;
-    }
-
-    int header_size = RESPONSE_HEADER_LENGTH;
-
-    switch (ctx->config.mode) {
-    case MiniModbusMode_RTU:
-        header_size += 3; // 2 byte CRC + 1 byte slave address
-        break;
-    case MiniModbusMode_TCP:
-        header_size += 7; // MBAP header
-        break;
-    }
-
-    // read response
-    int received = ctx->config.receive(ctx->config.user_data, ctx->buffer, header_size);
-    if (received != header_size) {
-        return MiniModbusError_Receive;
-    }
-
-    size_t total_received = received;
     size_t tcp_expected_length = 0;
     ctx->buffer_position = 0;
 
@@ -191,18 +748,8 @@ static MiniModbusError_t MiniModbus_SendRequestAndWaitResponse(MiniModbusContext
     uint16_t response_code = MiniModbus_ResponseReadByte(ctx);
     uint8_t error_code = 0;
 
-    // if not error, read rest of the response
-    if ((response_code & ERROR_CODE_BITMASK) == 0) {
-        received = ctx->config.receive(ctx->config.user_data, ctx->buffer + header_size, ctx->response_length - 1);
-
-        // didn't read full response
-        if (received != ctx->response_length - 1) {
-            return MiniModbusError_Receive;
-        }
-
-        total_received += received;
-    } else {
-        error_code = MiniModbus_ResponseReadByte(ctx);
+    if ((response_code & ERROR_CODE_BITMASK) != 0) {
+        error_code = ctx->buffer[ctx->buffer_position];
     }
 
     uint16_t crc;
@@ -231,65 +778,2273 @@ static MiniModbusError_t MiniModbus_SendRequestAndWaitResponse(MiniModbusContext
     return MiniModbusError_Success;
 }
 
-MiniModbusError_t MiniModbus_Init(MiniModbusContext_t *ctx, const MiniModbusConfig_t *config)
+/*
+ * Receive length bytes of a response, within the deadline of the response if a timeout is set.
+ */
+static MiniModbusError_t MiniModbus_Receive(MiniModbusContext_t *ctx, uint8_t *data, size_t length)
 {
-    if (ctx == NULL || config == NULL || config->receive == NULL || config->send == NULL ||
-        (config->mode != MiniModbusMode_RTU && config->mode != MiniModbusMode_TCP)) {
-        return MiniModbusError_InvalidArgument;
+    int received;
+
+    if (ctx->rto_us == 0) {
+        received = ctx->config.receive(ctx->config.user_data, data, length);
+    } else {
+        uint32_t timeout = ctx->rto_us;
+        if (ctx->config.clock != NULL) {
+            int32_t remaining = (int32_t)(ctx->deadline_us - MiniModbus_Now(ctx));
+            timeout = remaining > 0 ? (uint32_t)remaining : 0;
+        }
+
+        received = ctx->config.receive_timeout(ctx->config.user_data, data, length, timeout);
+        if (received >= 0 && (size_t)received < length) {
+            return MiniModbusError_Timeout;
+        }
     }
 
-    memset(ctx, 0, sizeof(MiniModbusContext_t));
-    memcpy(&ctx->config, config, sizeof(MiniModbusConfig_t));
+    if (received < 0 || (size_t)received != length) {
+        return MiniModbusError_Receive;
+    }
 
     return MiniModbusError_Success;
 }
 
-MiniModbusError_t MiniModbus_ReadHoldingRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t *value)
+/*
+ * Receive a response frame in the context buffer, storing in total_received the number of bytes received.
+ */
+static MiniModbusError_t MiniModbus_ResponseReceive(MiniModbusContext_t *ctx, size_t *total_received)
 {
-    if (ctx == NULL || value == NULL) {
-        return MiniModbusError_InvalidArgument;
-    }
+    int header_size = RESPONSE_HEADER_LENGTH;
 
-    MiniModbus_RequestStart(ctx, FUNCTION_READ_HOLDING_REGISTER, 3);
-    MiniModbus_RequestAddUInt16(ctx, reg);
-    MiniModbus_RequestAddUInt16(ctx, 1);
+    switch (ctx->config.mode) {
+    case MiniModbusMode_RTU:
+        header_size += 3; // 2 byte CRC + 1 byte slave address
+        break;
+    case MiniModbusMode_TCP:
+        header_size += 7; // MBAP header
+        break;
+    }
 
-    MiniModbusError_t error = MiniModbus_SendRequestAndWaitResponse(ctx);
+    // read response
+    MiniModbusError_t error = MiniModbus_Receive(ctx, ctx->buffer, header_size);
     if (error != MiniModbusError_Success) {
         return error;
     }
 
-    uint8_t response_size = MiniModbus_ResponseReadByte(ctx);
-    if (response_size != 2) {
-        return MiniModbusError_ResponseInvalidLength;
-    }
+    *total_received = header_size;
+
+    // if not error, read rest of the response
+    if ((ctx->buffer[MiniModbus_HeaderLength(ctx)] & ERROR_CODE_BITMASK) == 0) {
+        error = MiniModbus_Receive(ctx, ctx->buffer + header_size, ctx->response_length - 1);
+        if (error != MiniModbusError_Success) {
+            return error;
+        }
 
-    *value = MiniModbus_ResponseReadUIn16(ctx);
+        *total_received += ctx->response_length - 1;
+    }
 
     return MiniModbusError_Success;
 }
 
-MiniModbusError_t MiniModbus_WriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value)
+/*
+ * Adapt the timeout after waiting a response, as the TCP retransmission timeout (RFC 6298): a response is a sample of
+ * the response time of the slave, a timeout doubles the timeout. Responses to a request sent more times are not
+ * sampled, since they could answer any of the copies (Karn's algorithm).
+ */
+static void MiniModbus_TimeoutUpdate(MiniModbusContext_t *ctx, MiniModbusError_t error, uint32_t elapsed,
+                                     uint8_t attempt)
 {
-    if (ctx == NULL) {
-        return MiniModbusError_InvalidArgument;
+    uint64_t rto;
+
+    if (error == MiniModbusError_Timeout) {
+        rto = 2ULL * ctx->rto_us;
+    } else if (error >= 0 && attempt == 0) {
+        // a response faster than the clock resolution is a valid sample of 0, srtt_us can't tell the first one
+        if (!ctx->rtt_sampled) {
+            ctx->rtt_sampled = 1;
+            ctx->srtt_us = elapsed;
+            ctx->rttvar_us = elapsed / 2;
+        } else {
+            uint32_t delta = elapsed > ctx->srtt_us ? elapsed - ctx->srtt_us : ctx->srtt_us - elapsed;
+            ctx->rttvar_us = ctx->rttvar_us - ctx->rttvar_us / 4 + delta / 4;
+            ctx->srtt_us = ctx->srtt_us - ctx->srtt_us / 8 + elapsed / 8;
+        }
+        rto = ctx->srtt_us + 4ULL * ctx->rttvar_us;
+    } else {
+        return;
     }
 
-    MiniModbus_RequestStart(ctx, FUNCTION_WRITE_SINGLE_REGISTER, 4);
-    MiniModbus_RequestAddUInt16(ctx, reg);
-    MiniModbus_RequestAddUInt16(ctx, value);
+    if (rto < ctx->config.timeout_min_us) {
+        rto = ctx->config.timeout_min_us;
+    }
+    if (rto > ctx->config.timeout_us) {
+        rto = ctx->config.timeout_us;
+    }
+    ctx->rto_us = (uint32_t)rto;
+}
+
+/*
+ * Wait the response to a request just sent. attempt is 0 the first time the request is sent, then the number of the
+ * retry.
+ */
+static MiniModbusError_t MiniModbus_WaitResponse(MiniModbusContext_t *ctx, uint8_t attempt)
+{
+    size_t total_received = 0;
+
+    // the timeout runs from the end of the request, the time to send it on a slow line doesn't count
+    uint32_t start = MiniModbus_Now(ctx);
+    ctx->deadline_us = start + ctx->rto_us;
+
+    MiniModbusError_t error = MiniModbus_ResponseReceive(ctx, &total_received);
+    if (error == MiniModbusError_Success) {
+        error = MiniModbus_ResponseValidate(ctx, total_received);
+    }
+    MINI_MODBUS_STATS_RECEIVED(ctx, ctx->buffer, total_received, error);
 
-    MiniModbusError_t error = MiniModbus_SendRequestAndWaitResponse(ctx);
+    if (ctx->config.timeout_min_us != 0) {
+        MiniModbus_TimeoutUpdate(ctx, error, MiniModbus_Now(ctx) - start, attempt);
+    }
+
+    // resynchronize: whatever is left of a partial or garbled frame would corrupt the next response
+    if (error < 0 && ctx->config.flush != NULL) {
+        ctx->config.flush(ctx->config.user_data);
+    }
+
+    return error;
+}
+
+static MiniModbusError_t MiniModbus_SendRequestAndWaitResponse(MiniModbusContext_t *ctx, uint8_t attempt)
+{
+    MiniModbusError_t error = MiniModbus_PacketSend(ctx);
     if (error != MiniModbusError_Success) {
         return error;
     }
 
-    uint16_t response_reg = MiniModbus_ResponseReadUIn16(ctx);
-    uint16_t response_value = MiniModbus_ResponseReadUIn16(ctx);
+    return MiniModbus_WaitResponse(ctx, attempt);
+}
 
-    if (response_reg != reg || response_value != value) {
-        return MiniModbusError_ResponseInvalid;
+/*
+ * Whether to send again a request that failed with error: timeouts, send errors and lost or corrupted responses are
+ * retried, exceptions from the slave are not, since the slave got the request.
+ */
+static int MiniModbus_Retry(MiniModbusContext_t *ctx, MiniModbusError_t error, uint8_t attempt)
+{
+    if (error >= 0 || error == MiniModbusError_InvalidArgument || attempt >= ctx->config.retries) {
+        return 0;
     }
 
-    return MiniModbusError_Success;
+#ifdef MINI_MODBUS_STATS
+    ctx->stats.retries++;
+#endif /* MINI_MODBUS_STATS */
+
+    return 1;
+}
+
+static MiniModbusError_t MiniModbus_EncodeReadRegisters(MiniModbusContext_t *ctx, uint8_t function_code, uint16_t reg,
+                                                        uint16_t quantity)
+{
+    if (quantity == 0 || quantity > MINI_MODBUS_MAX_READ_REGISTERS || (uint32_t)reg + quantity > 0x10000) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // response is function code + byte count + 2 bytes for each register, it has to fit in the context buffer
+    uint8_t expected_response_length = 1 + quantity * 2;
+    if (MiniModbus_FrameOverhead(ctx) + 1 + expected_response_length > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_RequestStart(ctx, function_code, expected_response_length);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, quantity);
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeWriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value)
+{
+    MiniModbus_RequestStart(ctx, FUNCTION_WRITE_SINGLE_REGISTER, 4);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, value);
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t reg,
+                                                                 uint16_t quantity, const uint16_t *values)
+{
+    if (values == NULL || quantity == 0 || quantity > MINI_MODBUS_MAX_WRITE_REGISTERS ||
+        (uint32_t)reg + quantity > 0x10000) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // request is function code + address + quantity + byte count + 2 bytes for each register
+    if (MiniModbus_FrameOverhead(ctx) + 6 + quantity * 2 > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_RequestStart(ctx, FUNCTION_WRITE_MULTIPLE_REGISTERS, 4);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, quantity);
+    MiniModbus_RequestAddByte(ctx, quantity * 2);
+    for (uint16_t i = 0; i < quantity; i++) {
+        MiniModbus_RequestAddUInt16(ctx, values[i]);
+    }
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeReadWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t read_reg,
+                                                                     uint16_t read_quantity, uint16_t write_reg,
+                                                                     uint16_t write_quantity,
+                                                                     const uint16_t *write_values)
+{
+    if (write_values == NULL || read_quantity == 0 || read_quantity > MINI_MODBUS_MAX_READ_REGISTERS ||
+        (uint32_t)read_reg + read_quantity > 0x10000 || write_quantity == 0 ||
+        write_quantity > MINI_MODBUS_MAX_READ_WRITE_REGISTERS || (uint32_t)write_reg + write_quantity > 0x10000) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // both the request and the response have to fit in the context buffer
+    uint8_t expected_response_length = 1 + read_quantity * 2;
+    if (MiniModbus_FrameOverhead(ctx) + 1 + expected_response_length > MINI_MODBUS_BUFFER_SIZE ||
+        MiniModbus_FrameOverhead(ctx) + 10 + write_quantity * 2 > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_RequestStart(ctx, FUNCTION_READ_WRITE_MULTIPLE_REGISTERS, expected_response_length);
+    MiniModbus_RequestAddUInt16(ctx, read_reg);
+    MiniModbus_RequestAddUInt16(ctx, read_quantity);
+    MiniModbus_RequestAddUInt16(ctx, write_reg);
+    MiniModbus_RequestAddUInt16(ctx, write_quantity);
+    MiniModbus_RequestAddByte(ctx, write_quantity * 2);
+    for (uint16_t i = 0; i < write_quantity; i++) {
+        MiniModbus_RequestAddUInt16(ctx, write_values[i]);
+    }
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeReadBits(MiniModbusContext_t *ctx, uint8_t function_code, uint16_t reg,
+                                                   uint16_t quantity)
+{
+    if (quantity == 0 || quantity > MINI_MODBUS_MAX_READ_BITS || (uint32_t)reg + quantity > 0x10000) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // response is function code + byte count + 1 byte every 8 bits
+    uint8_t expected_response_length = 1 + (quantity + 7) / 8;
+    if (MiniModbus_FrameOverhead(ctx) + 1 + expected_response_length > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_RequestStart(ctx, function_code, expected_response_length);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, quantity);
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeWriteSingleCoil(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value)
+{
+    MiniModbus_RequestStart(ctx, FUNCTION_WRITE_SINGLE_COIL, 4);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, value);
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_EncodeWriteMultipleCoils(MiniModbusContext_t *ctx, uint16_t reg,
+                                                             uint16_t quantity, const uint8_t *values)
+{
+    if (values == NULL || quantity == 0 || quantity > MINI_MODBUS_MAX_WRITE_BITS ||
+        (uint32_t)reg + quantity > 0x10000) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // request is function code + address + quantity + byte count + 1 byte every 8 bits
+    uint8_t byte_count = (quantity + 7) / 8;
+    if (MiniModbus_FrameOverhead(ctx) + 6 + byte_count > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_RequestStart(ctx, FUNCTION_WRITE_MULTIPLE_COILS, 4);
+    MiniModbus_RequestAddUInt16(ctx, reg);
+    MiniModbus_RequestAddUInt16(ctx, quantity);
+    MiniModbus_RequestAddByte(ctx, byte_count);
+    MiniModbus_BitsPack(values, quantity, ctx->buffer + ctx->buffer_position);
+    ctx->buffer_position += byte_count;
+
+    return MiniModbusError_Success;
+}
+
+/*
+ * Decode the data part of a successful response, starting from the byte after the function code.
+ * For reads quantity is the number of registers or bits requested, and values an array of uint16_t or uint8_t.
+ * For write single register or coil it's the written value.
+ */
+static MiniModbusError_t MiniModbus_ResponseDecode(MiniModbusContext_t *ctx, uint8_t function_code, uint16_t reg,
+                                                   uint16_t quantity, void *values)
+{
+    uint16_t *registers = values;
+    uint16_t response_reg;
+    uint16_t response_value;
+
+    switch (function_code) {
+    case FUNCTION_READ_COILS:
+    case FUNCTION_READ_DISCRETE_INPUTS:
+        if (MiniModbus_ResponseReadByte(ctx) != (quantity + 7) / 8) {
+            return MiniModbusError_ResponseInvalidLength;
+        }
+        MiniModbus_BitsUnpack(ctx->buffer + ctx->buffer_position, quantity, values);
+        ctx->buffer_position += (quantity + 7) / 8;
+        break;
+    case FUNCTION_READ_HOLDING_REGISTER:
+    case FUNCTION_READ_INPUT_REGISTER:
+    case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+        if (MiniModbus_ResponseReadByte(ctx) != quantity * 2) {
+            return MiniModbusError_ResponseInvalidLength;
+        }
+        for (uint16_t i = 0; i < quantity; i++) {
+            registers[i] = MiniModbus_ResponseReadUIn16(ctx);
+        }
+        break;
+    case FUNCTION_WRITE_SINGLE_COIL:
+    case FUNCTION_WRITE_MULTIPLE_COILS:
+    case FUNCTION_WRITE_SINGLE_REGISTER:
+    case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+        response_reg = MiniModbus_ResponseReadUIn16(ctx);
+        response_value = MiniModbus_ResponseReadUIn16(ctx);
+        if (response_reg != reg || response_value != quantity) {
+            return MiniModbusError_ResponseInvalid;
+        }
+        break;
+    default:
+        return MiniModbusError_ResponseInvalidCode;
+    }
+
+    return MiniModbusError_Success;
+}
+
+static int MiniModbus_IsWrite(uint8_t function_code)
+{
+    return function_code == FUNCTION_WRITE_SINGLE_COIL || function_code == FUNCTION_WRITE_MULTIPLE_COILS ||
+           function_code == FUNCTION_WRITE_SINGLE_REGISTER || function_code == FUNCTION_WRITE_MULTIPLE_REGISTERS;
+}
+
+static int MiniModbus_IsBroadcast(const MiniModbusContext_t *ctx)
+{
+    return ctx->config.mode == MiniModbusMode_RTU && ctx->config.slave_address == MODBUS_RTU_BROADCAST_ADDRESS;
+}
+
+/*
+ * The arguments of a blocking request, to encode it again each time it's sent.
+ * For single writes quantity is the value to write.
+ */
+typedef struct MiniModbusRequest {
+    uint8_t function_code;
+    uint16_t reg;
+    uint16_t quantity;
+    uint16_t write_reg;
+    uint16_t write_quantity;
+    const void *write_values;
+    void *values;
+} MiniModbusRequest_t;
+
+static MiniModbusError_t MiniModbus_RequestEncode(MiniModbusContext_t *ctx, const MiniModbusRequest_t *request)
+{
+    switch (request->function_code) {
+    case FUNCTION_READ_COILS:
+    case FUNCTION_READ_DISCRETE_INPUTS:
+        return MiniModbus_EncodeReadBits(ctx, request->function_code, request->reg, request->quantity);
+    case FUNCTION_READ_HOLDING_REGISTER:
+    case FUNCTION_READ_INPUT_REGISTER:
+        return MiniModbus_EncodeReadRegisters(ctx, request->function_code, request->reg, request->quantity);
+    case FUNCTION_WRITE_SINGLE_COIL:
+        return MiniModbus_EncodeWriteSingleCoil(ctx, request->reg, request->quantity);
+    case FUNCTION_WRITE_SINGLE_REGISTER:
+        return MiniModbus_EncodeWriteSingleRegister(ctx, request->reg, request->quantity);
+    case FUNCTION_WRITE_MULTIPLE_COILS:
+        return MiniModbus_EncodeWriteMultipleCoils(ctx, request->reg, request->quantity, request->write_values);
+    case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+        return MiniModbus_EncodeWriteMultipleRegisters(ctx, request->reg, request->quantity, request->write_values);
+    case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+        return MiniModbus_EncodeReadWriteMultipleRegisters(ctx, request->reg, request->quantity, request->write_reg,
+                                                           request->write_quantity, request->write_values);
+    default:
+        return MiniModbusError_InvalidArgument;
+    }
+}
+
+static MiniModbusError_t MiniModbus_Transact(MiniModbusContext_t *ctx, const MiniModbusRequest_t *request)
+{
+    MiniModbusError_t error;
+    uint8_t attempt = 0;
+
+    do {
+        // the response overwrites the request in the context buffer, so it's encoded again at each attempt
+        error = MiniModbus_RequestEncode(ctx, request);
+        if (error != MiniModbusError_Success) {
+            return error;
+        }
+
+        // slaves don't answer to a broadcast, so it can only be a write
+        if (MiniModbus_IsBroadcast(ctx)) {
+            if (!MiniModbus_IsWrite(ctx->request_code)) {
+                return MiniModbusError_InvalidArgument;
+            }
+            error = MiniModbus_PacketSend(ctx);
+            MINI_MODBUS_STATS_COMPLETE(ctx, ctx->request_code, error, STATS_TIMING_NONE);
+            return error;
+        }
+
+        error = MiniModbus_SendRequestAndWaitResponse(ctx, attempt);
+        if (error == MiniModbusError_Success) {
+            error = MiniModbus_ResponseDecode(ctx, ctx->request_code, request->reg, request->quantity, request->values);
+        }
+        MINI_MODBUS_STATS_COMPLETE(ctx, ctx->request_code, error, STATS_TIMING_FULL);
+    } while (MiniModbus_Retry(ctx, error, attempt++));
+
+    return error;
+}
+
+MiniModbusError_t MiniModbus_Init(MiniModbusContext_t *ctx, const MiniModbusConfig_t *config)
+{
+    if (ctx == NULL || config == NULL || config->receive == NULL || config->send == NULL ||
+        (config->mode != MiniModbusMode_RTU && config->mode != MiniModbusMode_TCP)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // a timeout needs a way to stop waiting, an adaptive one a way to measure the response times
+    if ((config->timeout_us != 0 && config->receive_timeout == NULL) ||
+        (config->timeout_min_us != 0 && (config->clock == NULL || config->timeout_min_us > config->timeout_us))) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(ctx, 0, sizeof(MiniModbusContext_t));
+    memcpy(&ctx->config, config, sizeof(MiniModbusConfig_t));
+    ctx->rto_us = config->timeout_us;
+
+    return MiniModbusError_Success;
+}
+
+// the word orders as flags
+#define WORD_ORDER_SWAP_WORDS 1
+#define WORD_ORDER_SWAP_BYTES 2
+
+static uint16_t MiniModbus_Swap16(uint16_t value)
+{
+    return (uint16_t)((value << 8) | (value >> 8));
+}
+
+#if defined(MINI_MODBUS_HAVE_SSE2)
+
+static __m128i MiniModbus_Swap16x8(__m128i x)
+{
+    return _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+}
+
+#endif /* MINI_MODBUS_HAVE_SSE2 */
+
+/*
+ * On a little endian host the registers of a value, stored as uint16_t, and the value itself differ only by a
+ * permutation of the bytes: the same for decoding and encoding. Converts 16 bytes at a time, returning the number of
+ * values converted, the rest is left to the scalar code.
+ */
+static size_t MiniModbus_Permute32(const void *in, void *out, size_t count, MiniModbusWordOrder_t order)
+{
+    size_t i = 0;
+
+#if defined(MINI_MODBUS_HAVE_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)((const uint8_t *)in + i * 4));
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            x = MiniModbus_Swap16x8(x);
+        }
+        // the value is little endian: words are already in place for the least significant one first
+        if ((order & WORD_ORDER_SWAP_WORDS) == 0) {
+            x = _mm_or_si128(_mm_slli_epi32(x, 16), _mm_srli_epi32(x, 16));
+        }
+        _mm_storeu_si128((__m128i *)((uint8_t *)out + i * 4), x);
+    }
+#elif defined(MINI_MODBUS_HAVE_NEON)
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t x = vld1q_u8((const uint8_t *)in + i * 4);
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            x = vrev16q_u8(x);
+        }
+        if ((order & WORD_ORDER_SWAP_WORDS) == 0) {
+            x = vreinterpretq_u8_u16(vrev32q_u16(vreinterpretq_u16_u8(x)));
+        }
+        vst1q_u8((uint8_t *)out + i * 4, x);
+    }
+#else
+    (void)in;
+    (void)out;
+    (void)count;
+    (void)order;
+#endif
+
+    return i;
+}
+
+static size_t MiniModbus_Permute64(const void *in, void *out, size_t count, MiniModbusWordOrder_t order)
+{
+    size_t i = 0;
+
+#if defined(MINI_MODBUS_HAVE_SSE2)
+    for (; i + 2 <= count; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)((const uint8_t *)in + i * 8));
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            x = MiniModbus_Swap16x8(x);
+        }
+        if ((order & WORD_ORDER_SWAP_WORDS) == 0) {
+            x = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0x1B), 0x1B);
+        }
+        _mm_storeu_si128((__m128i *)((uint8_t *)out + i * 8), x);
+    }
+#elif defined(MINI_MODBUS_HAVE_NEON)
+    for (; i + 2 <= count; i += 2) {
+        uint8x16_t x = vld1q_u8((const uint8_t *)in + i * 8);
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            x = vrev16q_u8(x);
+        }
+        if ((order & WORD_ORDER_SWAP_WORDS) == 0) {
+            x = vreinterpretq_u8_u16(vrev64q_u16(vreinterpretq_u16_u8(x)));
+        }
+        vst1q_u8((uint8_t *)out + i * 8, x);
+    }
+#else
+    (void)in;
+    (void)out;
+    (void)count;
+    (void)order;
+#endif
+
+    return i;
+}
+
+void MiniModbus_Decode32(const uint16_t *registers, size_t count, MiniModbusWordOrder_t order, void *values)
+{
+    uint8_t *out = values;
+
+    for (size_t i = MiniModbus_Permute32(registers, values, count, order); i < count; i++) {
+        uint16_t high = registers[2 * i + ((order & WORD_ORDER_SWAP_WORDS) != 0)];
+        uint16_t low = registers[2 * i + ((order & WORD_ORDER_SWAP_WORDS) == 0)];
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            high = MiniModbus_Swap16(high);
+            low = MiniModbus_Swap16(low);
+        }
+        uint32_t value = ((uint32_t)high << 16) | low;
+        memcpy(out + i * 4, &value, 4);
+    }
+}
+
+void MiniModbus_Decode64(const uint16_t *registers, size_t count, MiniModbusWordOrder_t order, void *values)
+{
+    uint8_t *out = values;
+
+    for (size_t i = MiniModbus_Permute64(registers, values, count, order); i < count; i++) {
+        uint64_t value = 0;
+        for (size_t w = 0; w < 4; w++) {
+            uint16_t word = registers[4 * i + ((order & WORD_ORDER_SWAP_WORDS) != 0 ? 3 - w : w)];
+            if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+                word = MiniModbus_Swap16(word);
+            }
+            value = (value << 16) | word;
+        }
+        memcpy(out + i * 8, &value, 8);
+    }
+}
+
+void MiniModbus_Encode32(const void *values, size_t count, MiniModbusWordOrder_t order, uint16_t *registers)
+{
+    const uint8_t *in = values;
+
+    for (size_t i = MiniModbus_Permute32(values, registers, count, order); i < count; i++) {
+        uint32_t value;
+        memcpy(&value, in + i * 4, 4);
+        uint16_t high = value >> 16;
+        uint16_t low = value & 0xFFFF;
+        if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+            high = MiniModbus_Swap16(high);
+            low = MiniModbus_Swap16(low);
+        }
+        registers[2 * i + ((order & WORD_ORDER_SWAP_WORDS) != 0)] = high;
+        registers[2 * i + ((order & WORD_ORDER_SWAP_WORDS) == 0)] = low;
+    }
+}
+
+void MiniModbus_Encode64(const void *values, size_t count, MiniModbusWordOrder_t order, uint16_t *registers)
+{
+    const uint8_t *in = values;
+
+    for (size_t i = MiniModbus_Permute64(values, registers, count, order); i < count; i++) {
+        uint64_t value;
+        memcpy(&value, in + i * 8, 8);
+        for (size_t w = 0; w < 4; w++) {
+            uint16_t word = (value >> (48 - 16 * w)) & 0xFFFF;
+            if ((order & WORD_ORDER_SWAP_BYTES) != 0) {
+                word = MiniModbus_Swap16(word);
+            }
+            registers[4 * i + ((order & WORD_ORDER_SWAP_WORDS) != 0 ? 3 - w : w)] = word;
+        }
+    }
+}
+
+/*
+ * Read count values of width registers each, and decode them.
+ */
+static MiniModbusError_t MiniModbus_ReadTyped(MiniModbusContext_t *ctx, uint8_t function_code, uint16_t reg,
+                                              uint16_t count, size_t width, MiniModbusWordOrder_t order, void *values)
+{
+    uint16_t registers[MINI_MODBUS_MAX_READ_REGISTERS];
+
+    if (ctx == NULL || values == NULL || count == 0 || count * width > MINI_MODBUS_MAX_READ_REGISTERS) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = function_code, .reg = reg, .quantity = count * width, .values = registers};
+    MiniModbusError_t error = MiniModbus_Transact(ctx, &request);
+    if (error != MiniModbusError_Success) {
+        return error;
+    }
+
+    if (width == 2) {
+        MiniModbus_Decode32(registers, count, order, values);
+    } else {
+        MiniModbus_Decode64(registers, count, order, values);
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_ReadHoldingRegisters32(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                    MiniModbusWordOrder_t order, void *values)
+{
+    return MiniModbus_ReadTyped(ctx, FUNCTION_READ_HOLDING_REGISTER, reg, count, 2, order, values);
+}
+
+MiniModbusError_t MiniModbus_ReadHoldingRegisters64(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                    MiniModbusWordOrder_t order, void *values)
+{
+    return MiniModbus_ReadTyped(ctx, FUNCTION_READ_HOLDING_REGISTER, reg, count, 4, order, values);
+}
+
+MiniModbusError_t MiniModbus_ReadInputRegisters32(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                  MiniModbusWordOrder_t order, void *values)
+{
+    return MiniModbus_ReadTyped(ctx, FUNCTION_READ_INPUT_REGISTER, reg, count, 2, order, values);
+}
+
+MiniModbusError_t MiniModbus_ReadInputRegisters64(MiniModbusContext_t *ctx, uint16_t reg, uint16_t count,
+                                                  MiniModbusWordOrder_t order, void *values)
+{
+    return MiniModbus_ReadTyped(ctx, FUNCTION_READ_INPUT_REGISTER, reg, count, 4, order, values);
+}
+
+MiniModbusError_t MiniModbus_ReadCoils(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity, uint8_t *values)
+{
+    if (ctx == NULL || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_READ_COILS, .reg = reg, .quantity = quantity, .values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_ReadDiscreteInputs(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                uint8_t *values)
+{
+    if (ctx == NULL || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_READ_DISCRETE_INPUTS, .reg = reg, .quantity = quantity, .values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_WriteSingleCoil(MiniModbusContext_t *ctx, uint16_t reg, int value)
+{
+    if (ctx == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_WRITE_SINGLE_COIL, .reg = reg, .quantity = value ? MODBUS_COIL_ON : 0};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_WriteMultipleCoils(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                const uint8_t *values)
+{
+    if (ctx == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_WRITE_MULTIPLE_COILS, .reg = reg, .quantity = quantity, .write_values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_SetSlaveAddress(MiniModbusContext_t *ctx, uint8_t slave_address)
+{
+    if (ctx == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    ctx->config.slave_address = slave_address;
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_SetTimeout(MiniModbusContext_t *ctx, uint32_t timeout_us, uint8_t retries)
+{
+    if (ctx == NULL || (timeout_us != 0 && ctx->config.receive_timeout == NULL) ||
+        timeout_us < ctx->config.timeout_min_us) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    ctx->config.timeout_us = timeout_us;
+    ctx->config.retries = retries;
+    ctx->rto_us = timeout_us;
+    ctx->srtt_us = 0;
+    ctx->rttvar_us = 0;
+    ctx->rtt_sampled = 0;
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_ReadHoldingRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t *value)
+{
+    return MiniModbus_ReadHoldingRegisters(ctx, reg, 1, value);
+}
+
+MiniModbusError_t MiniModbus_ReadHoldingRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                  uint16_t *values)
+{
+    if (ctx == NULL || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_READ_HOLDING_REGISTER, .reg = reg, .quantity = quantity, .values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_ReadInputRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                uint16_t *values)
+{
+    if (ctx == NULL || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_READ_INPUT_REGISTER, .reg = reg, .quantity = quantity, .values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_WriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value)
+{
+    if (ctx == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {.function_code = FUNCTION_WRITE_SINGLE_REGISTER, .reg = reg, .quantity = value};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_WriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                   const uint16_t *values)
+{
+    if (ctx == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_WRITE_MULTIPLE_REGISTERS, .reg = reg, .quantity = quantity, .write_values = values};
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+MiniModbusError_t MiniModbus_ReadWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t read_reg,
+                                                        uint16_t read_quantity, uint16_t *read_values,
+                                                        uint16_t write_reg, uint16_t write_quantity,
+                                                        const uint16_t *write_values)
+{
+    if (ctx == NULL || read_values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusRequest_t request = {
+        .function_code = FUNCTION_READ_WRITE_MULTIPLE_REGISTERS,
+        .reg = read_reg,
+        .quantity = read_quantity,
+        .write_reg = write_reg,
+        .write_quantity = write_quantity,
+        .write_values = write_values,
+        .values = read_values,
+    };
+
+    return MiniModbus_Transact(ctx, &request);
+}
+
+/*
+ * Store the request just encoded in the context buffer into a frame.
+ */
+static MiniModbusError_t MiniModbus_FrameStore(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame,
+                                               MiniModbusError_t encode_error, uint16_t reg, uint16_t quantity)
+{
+    if (encode_error != MiniModbusError_Success) {
+        return encode_error;
+    }
+
+    MiniModbus_PacketFinalize(ctx);
+
+    frame->mode = ctx->config.mode;
+    frame->function_code = ctx->request_code;
+    frame->response_length = ctx->response_length;
+    frame->address = reg;
+    frame->quantity = quantity;
+    frame->length = ctx->buffer_position;
+    memcpy(frame->data, ctx->buffer, ctx->buffer_position);
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_FrameReadHoldingRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame,
+                                                       uint16_t reg, uint16_t quantity)
+{
+    if (ctx == NULL || frame == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_FrameStore(
+        ctx, frame, MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_HOLDING_REGISTER, reg, quantity), reg, quantity);
+}
+
+MiniModbusError_t MiniModbus_FrameReadInputRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame, uint16_t reg,
+                                                     uint16_t quantity)
+{
+    if (ctx == NULL || frame == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_FrameStore(
+        ctx, frame, MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_INPUT_REGISTER, reg, quantity), reg, quantity);
+}
+
+MiniModbusError_t MiniModbus_FrameWriteSingleRegister(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame, uint16_t reg,
+                                                      uint16_t value)
+{
+    if (ctx == NULL || frame == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_FrameStore(ctx, frame, MiniModbus_EncodeWriteSingleRegister(ctx, reg, value), reg, value);
+}
+
+MiniModbusError_t MiniModbus_FrameWriteMultipleRegisters(MiniModbusContext_t *ctx, MiniModbusFrame_t *frame,
+                                                         uint16_t reg, uint16_t quantity, const uint16_t *values)
+{
+    if (ctx == NULL || frame == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_FrameStore(ctx, frame, MiniModbus_EncodeWriteMultipleRegisters(ctx, reg, quantity, values), reg,
+                                 quantity);
+}
+
+MiniModbusError_t MiniModbus_FrameExecute(MiniModbusContext_t *ctx, const MiniModbusFrame_t *frame, uint16_t *values)
+{
+    if (ctx == NULL || frame == NULL || frame->length == 0 || frame->mode != ctx->config.mode) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    int is_write = MiniModbus_IsWrite(frame->function_code);
+    if ((!is_write && values == NULL) || (!is_write && MiniModbus_IsBroadcast(ctx))) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    ctx->request_code = frame->function_code;
+    ctx->response_length = frame->response_length;
+
+    MiniModbusError_t error;
+    uint8_t attempt = 0;
+
+    do {
+        MiniModbus_CacheInvalidateRequest(ctx, frame->data);
+
+#ifdef MINI_MODBUS_STATS
+        // trace the frame as it goes on the wire, with its transaction identifier
+        if (ctx->config.mode == MiniModbusMode_TCP && ctx->config.trace_send != NULL) {
+            memcpy(ctx->buffer, frame->data, frame->length);
+            MiniModbus_PutUInt16(ctx->buffer, ctx->current_tcp_transaction_identifier + 1);
+            MINI_MODBUS_STATS_SEND(ctx, ctx->buffer, frame->length);
+        } else {
+            MINI_MODBUS_STATS_SEND(ctx, frame->data, frame->length);
+        }
+#endif /* MINI_MODBUS_STATS */
+
+        int sent;
+        if (ctx->config.mode == MiniModbusMode_RTU) {
+            sent = ctx->config.send(ctx->config.user_data, frame->data, frame->length);
+        } else if (ctx->config.sendv != NULL) {
+            uint8_t header[MODBUS_TCP_FRAME_OVERHEAD];
+            memcpy(header, frame->data, MODBUS_TCP_FRAME_OVERHEAD);
+            MiniModbus_PutUInt16(header, ++ctx->current_tcp_transaction_identifier);
+
+            MiniModbusIoVec_t iov[2] = {
+                {header, MODBUS_TCP_FRAME_OVERHEAD},
+                {frame->data + MODBUS_TCP_FRAME_OVERHEAD, frame->length - MODBUS_TCP_FRAME_OVERHEAD},
+            };
+            sent = ctx->config.sendv(ctx->config.user_data, iov, 2);
+        } else {
+            memcpy(ctx->buffer, frame->data, frame->length);
+            MiniModbus_PutUInt16(ctx->buffer, ++ctx->current_tcp_transaction_identifier);
+            sent = ctx->config.send(ctx->config.user_data, ctx->buffer, frame->length);
+        }
+        MINI_MODBUS_STATS_SENT(ctx);
+
+        error = MiniModbusError_Send;
+        if (sent >= 0 && (size_t)sent == frame->length) {
+            error = MiniModbus_IsBroadcast(ctx) ? MiniModbusError_Success : MiniModbus_WaitResponse(ctx, attempt);
+        }
+        if (MiniModbus_IsBroadcast(ctx)) {
+            MINI_MODBUS_STATS_COMPLETE(ctx, frame->function_code, error, STATS_TIMING_NONE);
+            return error;
+        }
+        if (error == MiniModbusError_Success) {
+            error = MiniModbus_ResponseDecode(ctx, frame->function_code, frame->address, frame->quantity, values);
+        }
+        MINI_MODBUS_STATS_COMPLETE(ctx, frame->function_code, error, STATS_TIMING_FULL);
+    } while (MiniModbus_Retry(ctx, error, attempt++));
+
+    return error;
+}
+
+static int MiniModbus_PollIsForbidden(const MiniModbusPollLimits_t *limits, uint32_t first, uint32_t last)
+{
+    for (size_t i = 0; i < limits->hole_count; i++) {
+        uint32_t hole_first = limits->holes[i].start;
+        uint32_t hole_last = hole_first + limits->holes[i].count - 1;
+        if (limits->holes[i].count > 0 && first <= hole_last && hole_first <= last) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+MiniModbusError_t MiniModbus_PollPlanBuild(MiniModbusContext_t *ctx, MiniModbusPollPlan_t *plan,
+                                           MiniModbusTable_t table, MiniModbusPollPoint_t *points, size_t point_count,
+                                           const MiniModbusPollLimits_t *limits, MiniModbusPollBlock_t *blocks,
+                                           size_t max_blocks)
+{
+    static const MiniModbusPollLimits_t default_limits = {0};
+
+    if (ctx == NULL || plan == NULL || (points == NULL && point_count > 0) || (blocks == NULL && max_blocks > 0) ||
+        (table != MiniModbusTable_HoldingRegisters && table != MiniModbusTable_InputRegisters)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    if (limits == NULL) {
+        limits = &default_limits;
+    }
+
+    // the largest block that fits the context buffer
+    uint32_t max_quantity = (MINI_MODBUS_BUFFER_SIZE - MiniModbus_FrameOverhead(ctx) - 2) / 2;
+    if (max_quantity > MINI_MODBUS_MAX_READ_REGISTERS) {
+        max_quantity = MINI_MODBUS_MAX_READ_REGISTERS;
+    }
+    if (limits->max_quantity > 0 && limits->max_quantity < max_quantity) {
+        max_quantity = limits->max_quantity;
+    }
+
+    // sort the points by address (shell sort, no recursion and no allocation)
+    for (size_t gap = point_count / 2; gap > 0; gap /= 2) {
+        for (size_t i = gap; i < point_count; i++) {
+            MiniModbusPollPoint_t point = points[i];
+            size_t j = i;
+            while (j >= gap && points[j - gap].address > point.address) {
+                points[j] = points[j - gap];
+                j -= gap;
+            }
+            points[j] = point;
+        }
+    }
+
+    for (size_t i = 0; i < point_count; i++) {
+        if (MiniModbus_PollIsForbidden(limits, points[i].address, points[i].address)) {
+            return MiniModbusError_InvalidArgument;
+        }
+    }
+
+    // greedily extend the current block while the next point is close enough, the block doesn't get too long and
+    // no forbidden register would be read
+    size_t block_count = 0;
+    for (size_t i = 0; i < point_count; i++) {
+        uint32_t address = points[i].address;
+
+        if (block_count > 0) {
+            MiniModbusPollBlock_t *block = &blocks[block_count - 1];
+            uint32_t last = (uint32_t)block->start + block->quantity - 1;
+
+            if (address <= last) {
+                block->point_count++;
+                continue;
+            }
+            if (address - last - 1 <= limits->max_gap && address - block->start + 1 <= max_quantity &&
+                !MiniModbus_PollIsForbidden(limits, last + 1, address)) {
+                block->quantity = address - block->start + 1;
+                block->point_count++;
+                continue;
+            }
+        }
+
+        if (block_count == max_blocks) {
+            return MiniModbusError_InvalidArgument;
+        }
+
+        blocks[block_count].start = address;
+        blocks[block_count].quantity = 1;
+        blocks[block_count].first_point = i;
+        blocks[block_count].point_count = 1;
+        blocks[block_count].result = MiniModbusError_Success;
+        block_count++;
+    }
+
+    plan->function_code = table == MiniModbusTable_HoldingRegisters ? FUNCTION_READ_HOLDING_REGISTER
+                                                                     : FUNCTION_READ_INPUT_REGISTER;
+    plan->points = points;
+    plan->point_count = point_count;
+    plan->blocks = blocks;
+    plan->block_count = block_count;
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_PollPlanExecute(MiniModbusContext_t *ctx, MiniModbusPollPlan_t *plan)
+{
+    if (ctx == NULL || plan == NULL || MiniModbus_IsBroadcast(ctx)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusError_t result = MiniModbusError_Success;
+
+    for (size_t b = 0; b < plan->block_count; b++) {
+        MiniModbusPollBlock_t *block = &plan->blocks[b];
+
+        MiniModbusError_t error;
+        uint8_t attempt = 0;
+
+        do {
+            error = MiniModbus_EncodeReadRegisters(ctx, plan->function_code, block->start, block->quantity);
+            if (error != MiniModbusError_Success) {
+                break;
+            }
+
+            error = MiniModbus_SendRequestAndWaitResponse(ctx, attempt);
+            if (error == MiniModbusError_Success && MiniModbus_ResponseReadByte(ctx) != block->quantity * 2) {
+                error = MiniModbusError_ResponseInvalidLength;
+            }
+
+            // scatter the values straight from the response to the points of the block
+            if (error == MiniModbusError_Success) {
+                const uint8_t *data = ctx->buffer + ctx->buffer_position;
+                for (size_t i = block->first_point; i < block->first_point + block->point_count; i++) {
+                    *plan->points[i].value =
+                        MiniModbus_GetUInt16(data + (plan->points[i].address - block->start) * 2);
+                }
+            }
+            MINI_MODBUS_STATS_COMPLETE(ctx, plan->function_code, error, STATS_TIMING_FULL);
+        } while (MiniModbus_Retry(ctx, error, attempt++));
+
+        block->result = error;
+        if (error != MiniModbusError_Success && result == MiniModbusError_Success) {
+            result = error;
+        }
+    }
+
+    return result;
+}
+
+static MiniModbusCacheEntry_t *MiniModbus_CacheEntry(MiniModbusCache_t *cache, MiniModbusTable_t table,
+                                                      uint32_t address, uint32_t *ttl_ms)
+{
+    for (size_t i = 0; i < cache->range_count; i++) {
+        MiniModbusCacheRange_t *range = &cache->ranges[i];
+        if (range->table == table && address >= range->start && address - range->start < range->count) {
+            *ttl_ms = range->ttl_ms;
+            return &range->entries[address - range->start];
+        }
+    }
+
+    return NULL;
+}
+
+static MiniModbusError_t MiniModbus_CacheRead(MiniModbusCache_t *cache, MiniModbusTable_t table, uint16_t reg,
+                                              uint16_t quantity, uint16_t *values)
+{
+    if (cache == NULL || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    uint32_t now = cache->clock(cache->clock_user_data);
+    uint32_t ttl_ms;
+    uint16_t i;
+
+    for (i = 0; i < quantity; i++) {
+        MiniModbusCacheEntry_t *entry = MiniModbus_CacheEntry(cache, table, (uint32_t)reg + i, &ttl_ms);
+        if (entry == NULL || !entry->valid || now - entry->time >= ttl_ms) {
+            break;
+        }
+        values[i] = entry->value;
+    }
+
+    if (quantity > 0 && i == quantity) {
+        cache->hits++;
+        return MiniModbusError_Success;
+    }
+
+    cache->misses++;
+
+    MiniModbusError_t error = table == MiniModbusTable_HoldingRegisters
+                                  ? MiniModbus_ReadHoldingRegisters(cache->ctx, reg, quantity, values)
+                                  : MiniModbus_ReadInputRegisters(cache->ctx, reg, quantity, values);
+    if (error != MiniModbusError_Success) {
+        return error;
+    }
+
+    // the values are as old as the request, not the response
+    for (i = 0; i < quantity; i++) {
+        MiniModbusCacheEntry_t *entry = MiniModbus_CacheEntry(cache, table, (uint32_t)reg + i, &ttl_ms);
+        if (entry != NULL) {
+            entry->value = values[i];
+            entry->time = now;
+            entry->valid = 1;
+        }
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_CacheInit(MiniModbusCache_t *cache, MiniModbusContext_t *ctx,
+                                       MiniModbusCacheRange_t *ranges, size_t range_count,
+                                       uint32_t (*clock)(void *user_data), void *clock_user_data)
+{
+    if (cache == NULL || ctx == NULL || (ranges == NULL && range_count > 0) || clock == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    for (size_t i = 0; i < range_count; i++) {
+        if (ranges[i].entries == NULL || (uint32_t)ranges[i].start + ranges[i].count > 0x10000) {
+            return MiniModbusError_InvalidArgument;
+        }
+        memset(ranges[i].entries, 0, ranges[i].count * sizeof(MiniModbusCacheEntry_t));
+    }
+
+    memset(cache, 0, sizeof(MiniModbusCache_t));
+    cache->ctx = ctx;
+    cache->ranges = ranges;
+    cache->range_count = range_count;
+    cache->clock = clock;
+    cache->clock_user_data = clock_user_data;
+    ctx->cache = cache;
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_CacheDetach(MiniModbusCache_t *cache)
+{
+    if (cache != NULL && cache->ctx->cache == cache) {
+        cache->ctx->cache = NULL;
+    }
+}
+
+MiniModbusError_t MiniModbus_CacheReadHoldingRegister(MiniModbusCache_t *cache, uint16_t reg, uint16_t *value)
+{
+    return MiniModbus_CacheRead(cache, MiniModbusTable_HoldingRegisters, reg, 1, value);
+}
+
+MiniModbusError_t MiniModbus_CacheReadHoldingRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                       uint16_t *values)
+{
+    return MiniModbus_CacheRead(cache, MiniModbusTable_HoldingRegisters, reg, quantity, values);
+}
+
+MiniModbusError_t MiniModbus_CacheReadInputRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                     uint16_t *values)
+{
+    return MiniModbus_CacheRead(cache, MiniModbusTable_InputRegisters, reg, quantity, values);
+}
+
+MiniModbusError_t MiniModbus_CacheWriteSingleRegister(MiniModbusCache_t *cache, uint16_t reg, uint16_t value)
+{
+    if (cache == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // invalidate even if the write fails: the device may have executed it anyway
+    MiniModbus_CacheInvalidate(cache, MiniModbusTable_HoldingRegisters, reg, 1);
+
+    return MiniModbus_WriteSingleRegister(cache->ctx, reg, value);
+}
+
+MiniModbusError_t MiniModbus_CacheWriteMultipleRegisters(MiniModbusCache_t *cache, uint16_t reg, uint16_t quantity,
+                                                         const uint16_t *values)
+{
+    if (cache == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbus_CacheInvalidate(cache, MiniModbusTable_HoldingRegisters, reg, quantity);
+
+    return MiniModbus_WriteMultipleRegisters(cache->ctx, reg, quantity, values);
+}
+
+void MiniModbus_CacheInvalidate(MiniModbusCache_t *cache, MiniModbusTable_t table, uint16_t reg, uint16_t quantity)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cache->range_count; i++) {
+        MiniModbusCacheRange_t *range = &cache->ranges[i];
+        uint32_t first = reg > range->start ? reg : range->start;
+        uint32_t last = (uint32_t)reg + quantity < (uint32_t)range->start + range->count
+                            ? (uint32_t)reg + quantity
+                            : (uint32_t)range->start + range->count;
+
+        if (range->table != table) {
+            continue;
+        }
+        for (uint32_t address = first; address < last; address++) {
+            range->entries[address - range->start].valid = 0;
+        }
+    }
+}
+
+static void MiniModbus_TransactionPrepare(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                          uint16_t reg, uint16_t quantity, uint16_t *values)
+{
+    transaction->transaction_identifier = ctx->current_tcp_transaction_identifier;
+    transaction->function_code = ctx->request_code;
+    transaction->response_length = ctx->response_length;
+    transaction->address = reg;
+    transaction->quantity = quantity;
+    transaction->values = values;
+    transaction->result = MiniModbusError_Pending;
+}
+
+static MiniModbusError_t MiniModbus_PipelineSubmit(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                                   MiniModbusError_t encode_error, uint16_t reg, uint16_t quantity,
+                                                   uint16_t *values)
+{
+    if (encode_error != MiniModbusError_Success) {
+        return encode_error;
+    }
+
+    MiniModbus_TransactionPrepare(ctx, transaction, reg, quantity, values);
+
+    MiniModbusError_t error = MiniModbus_PacketSend(ctx);
+    if (error != MiniModbusError_Success) {
+        MINI_MODBUS_STATS_COMPLETE(ctx, transaction->function_code, error, STATS_TIMING_NONE);
+        transaction->result = error;
+        return error;
+    }
+
+    transaction->next = ctx->pipeline;
+    ctx->pipeline = transaction;
+    ctx->pipeline_pending++;
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_PipelineCheckArguments(MiniModbusContext_t *ctx,
+                                                           MiniModbusTransaction_t *transaction)
+{
+    if (ctx == NULL || transaction == NULL || ctx->config.mode != MiniModbusMode_TCP ||
+        transaction->result == MiniModbusError_Pending) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_PipelineReadHoldingRegisters(MiniModbusContext_t *ctx,
+                                                          MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                          uint16_t quantity, uint16_t *values)
+{
+    if (MiniModbus_PipelineCheckArguments(ctx, transaction) != MiniModbusError_Success || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_PipelineSubmit(ctx, transaction,
+                                     MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_HOLDING_REGISTER, reg, quantity),
+                                     reg, quantity, values);
+}
+
+MiniModbusError_t MiniModbus_PipelineReadInputRegisters(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                                        uint16_t reg, uint16_t quantity, uint16_t *values)
+{
+    if (MiniModbus_PipelineCheckArguments(ctx, transaction) != MiniModbusError_Success || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_PipelineSubmit(ctx, transaction,
+                                     MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_INPUT_REGISTER, reg, quantity),
+                                     reg, quantity, values);
+}
+
+MiniModbusError_t MiniModbus_PipelineWriteSingleRegister(MiniModbusContext_t *ctx,
+                                                         MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                         uint16_t value)
+{
+    if (MiniModbus_PipelineCheckArguments(ctx, transaction) != MiniModbusError_Success) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_PipelineSubmit(ctx, transaction, MiniModbus_EncodeWriteSingleRegister(ctx, reg, value), reg,
+                                     value, NULL);
+}
+
+MiniModbusError_t MiniModbus_PipelineWriteMultipleRegisters(MiniModbusContext_t *ctx,
+                                                            MiniModbusTransaction_t *transaction, uint16_t reg,
+                                                            uint16_t quantity, const uint16_t *values)
+{
+    if (MiniModbus_PipelineCheckArguments(ctx, transaction) != MiniModbusError_Success) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_PipelineSubmit(
+        ctx, transaction, MiniModbus_EncodeWriteMultipleRegisters(ctx, reg, quantity, values), reg, quantity, NULL);
+}
+
+/*
+ * Set the result of a transaction already removed from the pending list, and call its callback.
+ */
+static void MiniModbus_PipelineFinish(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                      MiniModbusError_t result)
+{
+    MINI_MODBUS_STATS_COMPLETE(ctx, transaction->function_code, result, STATS_TIMING_NONE);
+    transaction->result = result;
+    if (transaction->callback != NULL) {
+        transaction->callback(transaction);
+    }
+}
+
+static void MiniModbus_PipelineComplete(MiniModbusContext_t *ctx, MiniModbusTransaction_t *transaction,
+                                        MiniModbusError_t result)
+{
+    MiniModbusTransaction_t **link = &ctx->pipeline;
+    while (*link != transaction) {
+        link = &(*link)->next;
+    }
+    *link = transaction->next;
+    transaction->next = NULL;
+    ctx->pipeline_pending--;
+
+    MiniModbus_PipelineFinish(ctx, transaction, result);
+}
+
+/*
+ * After a timeout, a receive error or a frame of invalid length the connection is no longer in a known state: fail
+ * all the pending transactions and drop whatever is left of the frame, so that it doesn't get mixed with the responses
+ * to the next requests.
+ */
+static MiniModbusError_t MiniModbus_PipelineReceiveFailed(MiniModbusContext_t *ctx, MiniModbusError_t error)
+{
+    if (ctx->config.flush != NULL) {
+        ctx->config.flush(ctx->config.user_data);
+    }
+    MiniModbus_PipelineAbort(ctx, error);
+
+    return error;
+}
+
+MiniModbusError_t MiniModbus_PipelinePoll(MiniModbusContext_t *ctx)
+{
+    if (ctx == NULL || ctx->config.mode != MiniModbusMode_TCP || ctx->pipeline == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // the pending transactions have been sent already, the timeout runs from the start of the wait
+    ctx->deadline_us = MiniModbus_Now(ctx) + ctx->rto_us;
+
+    MiniModbusError_t error = MiniModbus_Receive(ctx, ctx->buffer, MODBUS_TCP_FRAME_OVERHEAD);
+    if (error != MiniModbusError_Success) {
+        return MiniModbus_PipelineReceiveFailed(ctx, error);
+    }
+
+    ctx->buffer_position = 0;
+    uint16_t transaction_identifier = MiniModbus_ResponseReadUIn16(ctx);
+    uint16_t protocol_identifier = MiniModbus_ResponseReadUIn16(ctx);
+    uint16_t tcp_length = MiniModbus_ResponseReadUIn16(ctx);
+    uint8_t slave_address = MiniModbus_ResponseReadByte(ctx);
+
+    // the length covers the unit identifier, already received, the function code and at least one more byte
+    if (tcp_length < 3 || tcp_length + 6 > MINI_MODBUS_BUFFER_SIZE) {
+        return MiniModbus_PipelineReceiveFailed(ctx, MiniModbusError_ResponseInvalidLength);
+    }
+
+    error = MiniModbus_Receive(ctx, ctx->buffer + MODBUS_TCP_FRAME_OVERHEAD, tcp_length - 1);
+    if (error != MiniModbusError_Success) {
+        return MiniModbus_PipelineReceiveFailed(ctx, error);
+    }
+    MINI_MODBUS_STATS_RECEIVED(ctx, ctx->buffer, tcp_length + 6, MiniModbusError_Success);
+
+    if (protocol_identifier != MODBUS_TCP_IP_PROTOCOL_IDENTIFIER) {
+        return MiniModbusError_ResponseInvalidProtocolIdentifier;
+    }
+
+    MiniModbusTransaction_t *transaction = ctx->pipeline;
+    while (transaction != NULL && transaction->transaction_identifier != transaction_identifier) {
+        transaction = transaction->next;
+    }
+
+    // a response that doesn't belong to any pending transaction is discarded
+    if (transaction == NULL) {
+        return MiniModbusError_ResponseInvalidTransactionIdentifier;
+    }
+
+    MiniModbusError_t result;
+    uint8_t response_code = MiniModbus_ResponseReadByte(ctx);
+    if (slave_address != ctx->config.slave_address) {
+        result = MiniModbusError_ResponseInvalidSlaveAddress;
+    } else if ((response_code & ERROR_CODE_BITMASK) != 0) {
+        result = tcp_length == 3 ? (MiniModbusError_t)MiniModbus_ResponseReadByte(ctx)
+                                 : MiniModbusError_ResponseInvalidLength;
+    } else if (response_code != transaction->function_code) {
+        result = MiniModbusError_ResponseInvalidCode;
+    } else if (tcp_length - 2 != transaction->response_length) {
+        result = MiniModbusError_ResponseInvalidLength;
+    } else {
+        result = MiniModbus_ResponseDecode(ctx, transaction->function_code, transaction->address,
+                                           transaction->quantity, transaction->values);
+    }
+
+    MiniModbus_PipelineComplete(ctx, transaction, result);
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_PipelineFlush(MiniModbusContext_t *ctx)
+{
+    if (ctx == NULL || ctx->config.mode != MiniModbusMode_TCP) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    while (ctx->pipeline != NULL) {
+        MiniModbusError_t error = MiniModbus_PipelinePoll(ctx);
+
+        // the poll already aborted the pending transactions
+        if (error == MiniModbusError_Receive || error == MiniModbusError_ResponseInvalidLength ||
+            error == MiniModbusError_Timeout) {
+            return error;
+        }
+    }
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_PipelineAbort(MiniModbusContext_t *ctx, MiniModbusError_t error)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    // callbacks can submit new transactions: only the ones pending now are aborted
+    MiniModbusTransaction_t *aborted = ctx->pipeline;
+    ctx->pipeline = NULL;
+    ctx->pipeline_pending = 0;
+
+    while (aborted != NULL) {
+        MiniModbusTransaction_t *next = aborted->next;
+        aborted->next = NULL;
+        MiniModbus_PipelineFinish(ctx, aborted, error);
+        aborted = next;
+    }
+}
+
+static MiniModbusError_t MiniModbus_AsyncStart(MiniModbusContext_t *ctx, MiniModbusError_t encode_error, uint16_t reg,
+                                               uint16_t quantity, uint16_t *values, const uint8_t **frame,
+                                               size_t *frame_length)
+{
+    if (encode_error != MiniModbusError_Success) {
+        return encode_error;
+    }
+
+    MiniModbus_PacketFinalize(ctx);
+    MiniModbus_CacheInvalidateRequest(ctx, ctx->buffer);
+    MiniModbus_TransactionPrepare(ctx, &ctx->async, reg, quantity, values);
+    MINI_MODBUS_STATS_SEND(ctx, ctx->buffer, ctx->buffer_position);
+
+    *frame = ctx->buffer;
+    *frame_length = ctx->buffer_position;
+    ctx->async_received = 0;
+
+    return MiniModbusError_Success;
+}
+
+static MiniModbusError_t MiniModbus_AsyncCheckArguments(MiniModbusContext_t *ctx, const uint8_t **frame,
+                                                        size_t *frame_length)
+{
+    // a broadcast has no response to wait for: use the blocking functions
+    if (ctx == NULL || frame == NULL || frame_length == NULL || MiniModbus_IsBroadcast(ctx)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // the request in progress still needs the context buffer
+    if (ctx->async.result == MiniModbusError_Pending) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_AsyncReadHoldingRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                       uint16_t *values, const uint8_t **frame, size_t *frame_length)
+{
+    if (MiniModbus_AsyncCheckArguments(ctx, frame, frame_length) != MiniModbusError_Success || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_AsyncStart(ctx,
+                                 MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_HOLDING_REGISTER, reg, quantity),
+                                 reg, quantity, values, frame, frame_length);
+}
+
+MiniModbusError_t MiniModbus_AsyncReadInputRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                     uint16_t *values, const uint8_t **frame, size_t *frame_length)
+{
+    if (MiniModbus_AsyncCheckArguments(ctx, frame, frame_length) != MiniModbusError_Success || values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_AsyncStart(ctx, MiniModbus_EncodeReadRegisters(ctx, FUNCTION_READ_INPUT_REGISTER, reg, quantity),
+                                 reg, quantity, values, frame, frame_length);
+}
+
+MiniModbusError_t MiniModbus_AsyncWriteSingleRegister(MiniModbusContext_t *ctx, uint16_t reg, uint16_t value,
+                                                      const uint8_t **frame, size_t *frame_length)
+{
+    if (MiniModbus_AsyncCheckArguments(ctx, frame, frame_length) != MiniModbusError_Success) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_AsyncStart(ctx, MiniModbus_EncodeWriteSingleRegister(ctx, reg, value), reg, value, NULL, frame,
+                                 frame_length);
+}
+
+MiniModbusError_t MiniModbus_AsyncWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t reg, uint16_t quantity,
+                                                         const uint16_t *values, const uint8_t **frame,
+                                                         size_t *frame_length)
+{
+    if (MiniModbus_AsyncCheckArguments(ctx, frame, frame_length) != MiniModbusError_Success) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_AsyncStart(ctx, MiniModbus_EncodeWriteMultipleRegisters(ctx, reg, quantity, values), reg,
+                                 quantity, NULL, frame, frame_length);
+}
+
+MiniModbusError_t MiniModbus_AsyncReadWriteMultipleRegisters(MiniModbusContext_t *ctx, uint16_t read_reg,
+                                                             uint16_t read_quantity, uint16_t *read_values,
+                                                             uint16_t write_reg, uint16_t write_quantity,
+                                                             const uint16_t *write_values, const uint8_t **frame,
+                                                             size_t *frame_length)
+{
+    if (MiniModbus_AsyncCheckArguments(ctx, frame, frame_length) != MiniModbusError_Success || read_values == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    return MiniModbus_AsyncStart(ctx,
+                                 MiniModbus_EncodeReadWriteMultipleRegisters(ctx, read_reg, read_quantity, write_reg,
+                                                                             write_quantity, write_values),
+                                 read_reg, read_quantity, read_values, frame, frame_length);
+}
+
+/*
+ * Number of bytes of the response frame being received, or 0 if not enough bytes were received to know it.
+ */
+static size_t MiniModbus_AsyncFrameLength(MiniModbusContext_t *ctx)
+{
+    size_t header_length = MiniModbus_HeaderLength(ctx);
+
+    if (ctx->config.mode == MiniModbusMode_TCP) {
+        if (ctx->async_received < 6) {
+            return 0;
+        }
+        return 6 + (((size_t)ctx->buffer[4] << 8) | ctx->buffer[5]);
+    }
+
+    if (ctx->async_received <= header_length) {
+        return 0;
+    }
+    if ((ctx->buffer[header_length] & ERROR_CODE_BITMASK) != 0) {
+        return MODBUS_RTU_FRAME_OVERHEAD + 2; // function code + exception code
+    }
+    return MODBUS_RTU_FRAME_OVERHEAD + 1 + ctx->async.response_length;
+}
+
+MiniModbusError_t MiniModbus_AsyncFeed(MiniModbusContext_t *ctx, const uint8_t *data, size_t length, size_t *consumed)
+{
+    if (ctx == NULL || (data == NULL && length > 0) || ctx->async.result != MiniModbusError_Pending) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    size_t used = 0;
+    size_t frame_length = MiniModbus_AsyncFrameLength(ctx);
+
+    // copy a byte at a time till the frame length is known, then the rest of the frame at once
+    while (used < length && (frame_length == 0 || ctx->async_received < frame_length)) {
+        size_t chunk = frame_length == 0 ? 1 : frame_length - ctx->async_received;
+        if (chunk > length - used) {
+            chunk = length - used;
+        }
+        memcpy(ctx->buffer + ctx->async_received, data + used, chunk);
+        ctx->async_received += chunk;
+        used += chunk;
+
+        if (frame_length == 0) {
+            frame_length = MiniModbus_AsyncFrameLength(ctx);
+
+            // the length field of a TCP response must be at least 3 and the frame must fit the buffer
+            if (frame_length != 0 && (frame_length < MiniModbus_FrameOverhead(ctx) + 2 ||
+                                      frame_length > MINI_MODBUS_BUFFER_SIZE)) {
+                ctx->async.result = MiniModbusError_ResponseInvalidLength;
+                break;
+            }
+        }
+    }
+
+    if (consumed != NULL) {
+        *consumed = used;
+    }
+
+    if (ctx->async.result != MiniModbusError_Pending) {
+        MINI_MODBUS_STATS_RECEIVED(ctx, ctx->buffer, ctx->async_received, ctx->async.result);
+        MINI_MODBUS_STATS_COMPLETE(ctx, ctx->async.function_code, ctx->async.result, STATS_TIMING_TOTAL);
+        return ctx->async.result;
+    }
+
+    if (frame_length == 0 || ctx->async_received < frame_length) {
+        return MiniModbusError_Pending;
+    }
+
+    MiniModbusError_t error = MiniModbus_ResponseValidate(ctx, frame_length);
+    MINI_MODBUS_STATS_RECEIVED(ctx, ctx->buffer, frame_length, error);
+    if (error == MiniModbusError_Success) {
+        // a successful response must have exactly the expected length
+        if (frame_length != MiniModbus_FrameOverhead(ctx) + 1 + ctx->async.response_length) {
+            error = MiniModbusError_ResponseInvalidLength;
+        } else {
+            error = MiniModbus_ResponseDecode(ctx, ctx->async.function_code, ctx->async.address,
+                                              ctx->async.quantity, ctx->async.values);
+        }
+    }
+    MINI_MODBUS_STATS_COMPLETE(ctx, ctx->async.function_code, error, STATS_TIMING_TOTAL);
+
+    ctx->async.result = error;
+
+    return error;
+}
+
+void MiniModbus_AsyncCancel(MiniModbusContext_t *ctx)
+{
+    if (ctx == NULL) {
+        return;
+    }
+
+    ctx->async.result = MiniModbusError_Success;
+    ctx->async_received = 0;
+}
+
+size_t MiniModbus_FrameLength(MiniModbusMode_t mode, int request, const uint8_t *frame, size_t available)
+{
+    if (mode == MiniModbusMode_TCP) {
+        return available < 6 ? 6 : 6 + (size_t)MiniModbus_GetUInt16(frame + 4);
+    }
+
+    // RTU: slave address, PDU, 2 byte CRC
+    if (available < 2) {
+        return 2;
+    }
+
+    const uint8_t *pdu = frame + 1;
+    size_t pdu_available = available - 1;
+    size_t pdu_length;
+
+    if ((pdu[0] & ERROR_CODE_BITMASK) != 0) {
+        pdu_length = request ? 0 : 2;
+    } else if (request) {
+        switch (pdu[0]) {
+        case FUNCTION_READ_COILS:
+        case FUNCTION_READ_DISCRETE_INPUTS:
+        case FUNCTION_READ_HOLDING_REGISTER:
+        case FUNCTION_READ_INPUT_REGISTER:
+        case FUNCTION_WRITE_SINGLE_COIL:
+        case FUNCTION_WRITE_SINGLE_REGISTER:
+            pdu_length = 5;
+            break;
+        case FUNCTION_WRITE_MULTIPLE_COILS:
+        case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+            if (pdu_available < 6) {
+                return 1 + 6;
+            }
+            pdu_length = 6 + (size_t)pdu[5];
+            break;
+        case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+            if (pdu_available < 10) {
+                return 1 + 10;
+            }
+            pdu_length = 10 + (size_t)pdu[9];
+            break;
+        default:
+            pdu_length = 0;
+            break;
+        }
+    } else {
+        switch (pdu[0]) {
+        case FUNCTION_READ_COILS:
+        case FUNCTION_READ_DISCRETE_INPUTS:
+        case FUNCTION_READ_HOLDING_REGISTER:
+        case FUNCTION_READ_INPUT_REGISTER:
+        case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+            if (pdu_available < 2) {
+                return 1 + 2;
+            }
+            pdu_length = 2 + (size_t)pdu[1];
+            break;
+        case FUNCTION_WRITE_SINGLE_COIL:
+        case FUNCTION_WRITE_SINGLE_REGISTER:
+        case FUNCTION_WRITE_MULTIPLE_COILS:
+        case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+            pdu_length = 5;
+            break;
+        default:
+            pdu_length = 0;
+            break;
+        }
+    }
+
+    return pdu_length == 0 ? 0 : 1 + pdu_length + 2;
+}
+
+static int MiniModbus_ServerBitGet(const MiniModbusBits_t *table, size_t index)
+{
+    return (table->bits[index / 8] >> (index % 8)) & 1;
+}
+
+static void MiniModbus_ServerBitSet(MiniModbusBits_t *table, size_t index, int value)
+{
+    if (value) {
+        table->bits[index / 8] |= 1 << (index % 8);
+    } else {
+        table->bits[index / 8] &= ~(1 << (index % 8));
+    }
+}
+
+static int MiniModbus_ServerInRange(size_t start, size_t count, uint16_t address, uint16_t quantity)
+{
+    return address >= start && (size_t)address + quantity <= start + count;
+}
+
+static void MiniModbus_ServerNotify(MiniModbusServer_t *server, MiniModbusTable_t table, uint16_t address,
+                                    uint16_t quantity)
+{
+    if (server->on_write != NULL) {
+        server->on_write(server, table, address, quantity);
+    }
+}
+
+/*
+ * Execute the request PDU, writing the response PDU. Returns 0 or the exception code to send back.
+ */
+static uint8_t MiniModbus_ServerExecute(MiniModbusServer_t *server, const uint8_t *pdu, size_t length,
+                                        uint8_t *response, size_t *response_length)
+{
+    // each function checks the length, so that an unknown function is reported as such even in a short request
+    uint8_t function_code = pdu[0];
+    uint16_t address = length >= 5 ? MiniModbus_GetUInt16(pdu + 1) : 0;
+    uint16_t quantity = length >= 5 ? MiniModbus_GetUInt16(pdu + 3) : 0;
+    const MiniModbusRegisters_t *registers;
+    MiniModbusBits_t *bits;
+    size_t offset;
+
+    response[0] = function_code;
+
+    switch (function_code) {
+    case FUNCTION_READ_COILS:
+    case FUNCTION_READ_DISCRETE_INPUTS:
+        bits = function_code == FUNCTION_READ_COILS ? &server->coils : &server->discrete_inputs;
+        if (length != 5 || quantity == 0 || quantity > MINI_MODBUS_MAX_READ_BITS) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(bits->start, bits->count, address, quantity)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        offset = address - bits->start;
+        response[1] = (quantity + 7) / 8;
+        memset(response + 2, 0, response[1]);
+        for (uint16_t i = 0; i < quantity; i++) {
+            response[2 + i / 8] |= MiniModbus_ServerBitGet(bits, offset + i) << (i % 8);
+        }
+        *response_length = 2 + response[1];
+        break;
+    case FUNCTION_READ_HOLDING_REGISTER:
+    case FUNCTION_READ_INPUT_REGISTER:
+        registers = function_code == FUNCTION_READ_HOLDING_REGISTER ? &server->holding_registers
+                                                                    : &server->input_registers;
+        if (length != 5 || quantity == 0 || quantity > MINI_MODBUS_MAX_READ_REGISTERS) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(registers->start, registers->count, address, quantity)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        offset = address - registers->start;
+        response[1] = quantity * 2;
+        for (uint16_t i = 0; i < quantity; i++) {
+            MiniModbus_PutUInt16(response + 2 + i * 2, registers->values[offset + i]);
+        }
+        *response_length = 2 + response[1];
+        break;
+    case FUNCTION_WRITE_SINGLE_COIL:
+        if (length != 5 || (quantity != MODBUS_COIL_ON && quantity != 0)) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(server->coils.start, server->coils.count, address, 1)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        MiniModbus_ServerBitSet(&server->coils, address - server->coils.start, quantity == MODBUS_COIL_ON);
+        MiniModbus_ServerNotify(server, MiniModbusTable_Coils, address, 1);
+        memcpy(response + 1, pdu + 1, 4);
+        *response_length = 5;
+        break;
+    case FUNCTION_WRITE_SINGLE_REGISTER:
+        if (length != 5) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(server->holding_registers.start, server->holding_registers.count, address, 1)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        server->holding_registers.values[address - server->holding_registers.start] = quantity;
+        MiniModbus_ServerNotify(server, MiniModbusTable_HoldingRegisters, address, 1);
+        memcpy(response + 1, pdu + 1, 4);
+        *response_length = 5;
+        break;
+    case FUNCTION_WRITE_MULTIPLE_COILS:
+        if (quantity == 0 || quantity > MINI_MODBUS_MAX_WRITE_BITS || length < 6 || pdu[5] != (quantity + 7) / 8 ||
+            length != 6 + (size_t)pdu[5]) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(server->coils.start, server->coils.count, address, quantity)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        offset = address - server->coils.start;
+        for (uint16_t i = 0; i < quantity; i++) {
+            MiniModbus_ServerBitSet(&server->coils, offset + i, (pdu[6 + i / 8] >> (i % 8)) & 1);
+        }
+        MiniModbus_ServerNotify(server, MiniModbusTable_Coils, address, quantity);
+        memcpy(response + 1, pdu + 1, 4);
+        *response_length = 5;
+        break;
+    case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+        if (quantity == 0 || quantity > MINI_MODBUS_MAX_WRITE_REGISTERS || length < 6 || pdu[5] != quantity * 2 ||
+            length != 6 + (size_t)pdu[5]) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(server->holding_registers.start, server->holding_registers.count, address,
+                                      quantity)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        offset = address - server->holding_registers.start;
+        for (uint16_t i = 0; i < quantity; i++) {
+            server->holding_registers.values[offset + i] = MiniModbus_GetUInt16(pdu + 6 + i * 2);
+        }
+        MiniModbus_ServerNotify(server, MiniModbusTable_HoldingRegisters, address, quantity);
+        memcpy(response + 1, pdu + 1, 4);
+        *response_length = 5;
+        break;
+    case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS: {
+        if (length < 10) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        uint16_t write_address = MiniModbus_GetUInt16(pdu + 5);
+        uint16_t write_quantity = MiniModbus_GetUInt16(pdu + 7);
+        registers = &server->holding_registers;
+        if (quantity == 0 || quantity > MINI_MODBUS_MAX_READ_REGISTERS || write_quantity == 0 ||
+            write_quantity > MINI_MODBUS_MAX_READ_WRITE_REGISTERS || pdu[9] != write_quantity * 2 ||
+            length != 10 + (size_t)pdu[9]) {
+            return MiniModbusError_IllegalDataValue;
+        }
+        if (!MiniModbus_ServerInRange(registers->start, registers->count, address, quantity) ||
+            !MiniModbus_ServerInRange(registers->start, registers->count, write_address, write_quantity)) {
+            return MiniModbusError_IllegalDataAddress;
+        }
+        // the write is performed before the read
+        offset = write_address - registers->start;
+        for (uint16_t i = 0; i < write_quantity; i++) {
+            registers->values[offset + i] = MiniModbus_GetUInt16(pdu + 10 + i * 2);
+        }
+        MiniModbus_ServerNotify(server, MiniModbusTable_HoldingRegisters, write_address, write_quantity);
+        offset = address - registers->start;
+        response[1] = quantity * 2;
+        for (uint16_t i = 0; i < quantity; i++) {
+            MiniModbus_PutUInt16(response + 2 + i * 2, registers->values[offset + i]);
+        }
+        *response_length = 2 + response[1];
+        break;
+    }
+    default:
+        return MiniModbusError_IllegalFunction;
+    }
+
+    return 0;
+}
+
+MiniModbusError_t MiniModbus_ServerInit(MiniModbusServer_t *server, const MiniModbusConfig_t *config)
+{
+    if (server == NULL || config == NULL ||
+        (config->mode != MiniModbusMode_RTU && config->mode != MiniModbusMode_TCP)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(server, 0, sizeof(MiniModbusServer_t));
+    memcpy(&server->config, config, sizeof(MiniModbusConfig_t));
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_ServerHandleFrame(MiniModbusServer_t *server, const uint8_t *request,
+                                               size_t request_length, uint8_t *response, size_t *response_length)
+{
+    if (server == NULL || request == NULL || response == NULL || response_length == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    MiniModbusMode_t mode = server->config.mode;
+    size_t header_length = mode == MiniModbusMode_TCP ? MODBUS_TCP_FRAME_OVERHEAD : 1;
+    size_t pdu_length;
+    int broadcast = 0;
+
+    *response_length = 0;
+
+    if (mode == MiniModbusMode_RTU) {
+        if (request_length < MODBUS_RTU_FRAME_OVERHEAD + 1) {
+            return MiniModbusError_ResponseInvalidLength;
+        }
+        uint16_t crc = MiniModbus_Crc16(request, request_length - 2);
+        if (request[request_length - 2] != (crc & 0xFF) || request[request_length - 1] != ((crc >> 8) & 0xFF)) {
+            return MiniModbusError_InvalidCrc;
+        }
+        // frames for other slaves on the bus are silently ignored
+        if (request[0] != server->config.slave_address && request[0] != MODBUS_RTU_BROADCAST_ADDRESS) {
+            return MiniModbusError_Success;
+        }
+        broadcast = request[0] == MODBUS_RTU_BROADCAST_ADDRESS;
+        pdu_length = request_length - MODBUS_RTU_FRAME_OVERHEAD;
+    } else {
+        if (request_length < MODBUS_TCP_FRAME_OVERHEAD + 1 ||
+            MiniModbus_GetUInt16(request + 4) != request_length - 6) {
+            return MiniModbusError_ResponseInvalidLength;
+        }
+        if (MiniModbus_GetUInt16(request + 2) != MODBUS_TCP_IP_PROTOCOL_IDENTIFIER) {
+            return MiniModbusError_ResponseInvalidProtocolIdentifier;
+        }
+        if (request[6] != server->config.slave_address && request[6] != MODBUS_TCP_ANY_UNIT_IDENTIFIER) {
+            return MiniModbusError_ResponseInvalidSlaveAddress;
+        }
+        pdu_length = request_length - MODBUS_TCP_FRAME_OVERHEAD;
+    }
+
+    size_t response_pdu_length = 0;
+    uint8_t exception =
+        MiniModbus_ServerExecute(server, request + header_length, pdu_length, response + header_length,
+                                 &response_pdu_length);
+
+    // no response is sent to broadcast requests
+    if (broadcast) {
+        return MiniModbusError_Success;
+    }
+
+    if (exception != 0) {
+        response[header_length] = request[header_length] | ERROR_CODE_BITMASK;
+        response[header_length + 1] = exception;
+        response_pdu_length = 2;
+    }
+
+    memcpy(response, request, header_length);
+    *response_length = header_length + response_pdu_length;
+
+    if (mode == MiniModbusMode_TCP) {
+        MiniModbus_PutUInt16(response + 4, *response_length - 6);
+    } else {
+        uint16_t crc = MiniModbus_Crc16(response, *response_length);
+        response[(*response_length)++] = crc & 0xFF;
+        response[(*response_length)++] = (crc >> 8) & 0xFF;
+    }
+
+    return MiniModbusError_Success;
+}
+
+/*
+ * Discard the rest of a request whose length is unknown, so that it isn't taken for the start of the next one: with
+ * the flush callback if set, otherwise by reading till the line is silent for the timeout.
+ */
+static void MiniModbus_ServerResynchronize(MiniModbusServer_t *server)
+{
+    if (server->config.flush != NULL) {
+        server->config.flush(server->config.user_data);
+    } else if (server->config.receive_timeout != NULL && server->config.timeout_us != 0) {
+        while (server->config.receive_timeout(server->config.user_data, server->buffer, sizeof(server->buffer),
+                                              server->config.timeout_us) > 0) {
+        }
+    }
+}
+
+MiniModbusError_t MiniModbus_ServerPoll(MiniModbusServer_t *server)
+{
+    if (server == NULL || server->config.receive == NULL || server->config.send == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    size_t received = 0;
+    size_t length;
+
+    // receive the request in as few calls as the frame format allows
+    while ((length = MiniModbus_FrameLength(server->config.mode, 1, server->buffer, received)) > received) {
+        if (length > MINI_MODBUS_MAX_FRAME_SIZE) {
+            MiniModbus_ServerResynchronize(server);
+            return MiniModbusError_ResponseInvalidLength;
+        }
+        int result = server->config.receive(server->config.user_data, server->buffer + received, length - received);
+        if (result < 0 || (size_t)result != length - received) {
+            return MiniModbusError_Receive;
+        }
+        received = length;
+    }
+
+    // RTU request with an unknown function: its length is unknown too
+    if (length == 0) {
+        MiniModbus_ServerResynchronize(server);
+        return MiniModbusError_ResponseInvalidCode;
+    }
+
+    size_t response_length;
+    MiniModbusError_t error =
+        MiniModbus_ServerHandleFrame(server, server->buffer, received, server->response, &response_length);
+    if (error != MiniModbusError_Success || response_length == 0) {
+        return error;
+    }
+
+    int sent = server->config.send(server->config.user_data, server->response, response_length);
+    if (sent < 0 || (size_t)sent != response_length) {
+        return MiniModbusError_Send;
+    }
+
+    return MiniModbusError_Success;
+}
+
+#if MINI_MODBUS_RECEIVE_BUFFER_SIZE < MINI_MODBUS_MAX_FRAME_SIZE
+#error "MINI_MODBUS_RECEIVE_BUFFER_SIZE must be at least MINI_MODBUS_MAX_FRAME_SIZE"
+#endif
+
+/*
+ * Read from the transport till at least length bytes are buffered. With a timeout the bytes buffered so far are left
+ * when the transport has nothing more to read in time.
+ */
+static int MiniModbus_BufferedTransportFill(MiniModbusBufferedTransport_t *transport, size_t length, int use_timeout,
+                                            uint32_t timeout_us)
+{
+    uint32_t start = transport->clock != NULL ? transport->clock(transport->user_data) : 0;
+
+    if (length > MINI_MODBUS_RECEIVE_BUFFER_SIZE) {
+        return -1;
+    }
+
+    while (transport->end - transport->start < length) {
+        // make room at the end of the buffer for the rest of the data
+        if (transport->start > 0 && MINI_MODBUS_RECEIVE_BUFFER_SIZE - transport->start < length) {
+            memmove(transport->buffer, transport->buffer + transport->start, transport->end - transport->start);
+            transport->end -= transport->start;
+            transport->start = 0;
+        }
+
+        void *free_space = transport->buffer + transport->end;
+        size_t free_length = MINI_MODBUS_RECEIVE_BUFFER_SIZE - transport->end;
+        int result;
+        if (use_timeout) {
+            uint32_t remaining = timeout_us;
+            if (transport->clock != NULL) {
+                uint32_t elapsed = transport->clock(transport->user_data) - start;
+                remaining = elapsed < timeout_us ? timeout_us - elapsed : 0;
+            }
+            result = transport->read_timeout(transport->user_data, free_space, free_length, remaining);
+            if (result == 0) {
+                return 0;
+            }
+        } else {
+            result = transport->read(transport->user_data, free_space, free_length);
+        }
+        if (result <= 0) {
+            return -1;
+        }
+        transport->end += result;
+    }
+
+    return 0;
+}
+
+/*
+ * Move up to length buffered bytes to data, returning how many.
+ */
+static int MiniModbus_BufferedTransportTake(MiniModbusBufferedTransport_t *transport, void *data, size_t length)
+{
+    if (length > transport->end - transport->start) {
+        length = transport->end - transport->start;
+    }
+
+    memcpy(data, transport->buffer + transport->start, length);
+    transport->start += length;
+    if (transport->start == transport->end) {
+        transport->start = 0;
+        transport->end = 0;
+    }
+
+    return (int)length;
+}
+
+static int MiniModbus_BufferedTransportReceive(void *user_data, void *data, size_t length)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    if (MiniModbus_BufferedTransportFill(transport, length, 0, 0) < 0) {
+        return -1;
+    }
+
+    return MiniModbus_BufferedTransportTake(transport, data, length);
+}
+
+static int MiniModbus_BufferedTransportReceiveTimeout(void *user_data, void *data, size_t length, uint32_t timeout_us)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    if (MiniModbus_BufferedTransportFill(transport, length, 1, timeout_us) < 0) {
+        return -1;
+    }
+
+    return MiniModbus_BufferedTransportTake(transport, data, length);
+}
+
+static int MiniModbus_BufferedTransportSend(void *user_data, const void *data, size_t length)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    return transport->send(transport->user_data, data, length);
+}
+
+static int MiniModbus_BufferedTransportSendv(void *user_data, const MiniModbusIoVec_t *iov, size_t iov_count)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    return transport->sendv(transport->user_data, iov, iov_count);
+}
+
+static void MiniModbus_BufferedTransportFlushCallback(void *user_data)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    MiniModbus_BufferedTransportFlush(transport);
+    if (transport->flush != NULL) {
+        transport->flush(transport->user_data);
+    }
+}
+
+static uint32_t MiniModbus_BufferedTransportClock(void *user_data)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    return transport->clock(transport->user_data);
+}
+
+#ifdef MINI_MODBUS_STATS
+
+static void MiniModbus_BufferedTransportTraceSend(void *user_data, const uint8_t *frame, size_t length)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    transport->trace_send(transport->user_data, frame, length);
+}
+
+static void MiniModbus_BufferedTransportTraceReceive(void *user_data, const uint8_t *frame, size_t length,
+                                                     MiniModbusError_t result)
+{
+    MiniModbusBufferedTransport_t *transport = user_data;
+
+    transport->trace_receive(transport->user_data, frame, length, result);
+}
+
+#endif /* MINI_MODBUS_STATS */
+
+MiniModbusError_t MiniModbus_BufferedTransportInit(MiniModbusBufferedTransport_t *transport, MiniModbusConfig_t *config)
+{
+    if (transport == NULL || config == NULL || config->receive == NULL || config->send == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    transport->user_data = config->user_data;
+    transport->read = config->receive;
+    transport->read_timeout = config->receive_timeout;
+    transport->send = config->send;
+    transport->sendv = config->sendv;
+    transport->flush = config->flush;
+    transport->clock = config->clock;
+    transport->start = 0;
+    transport->end = 0;
+
+    // every callback gets the transport as user data, so the ones not wrapped by this layer are forwarded
+    config->user_data = transport;
+    config->receive = MiniModbus_BufferedTransportReceive;
+    config->send = MiniModbus_BufferedTransportSend;
+    config->flush = MiniModbus_BufferedTransportFlushCallback;
+    if (config->receive_timeout != NULL) {
+        config->receive_timeout = MiniModbus_BufferedTransportReceiveTimeout;
+    }
+    if (config->sendv != NULL) {
+        config->sendv = MiniModbus_BufferedTransportSendv;
+    }
+    if (config->clock != NULL) {
+        config->clock = MiniModbus_BufferedTransportClock;
+    }
+#ifdef MINI_MODBUS_STATS
+    transport->trace_send = config->trace_send;
+    transport->trace_receive = config->trace_receive;
+    if (config->trace_send != NULL) {
+        config->trace_send = MiniModbus_BufferedTransportTraceSend;
+    }
+    if (config->trace_receive != NULL) {
+        config->trace_receive = MiniModbus_BufferedTransportTraceReceive;
+    }
+#endif /* MINI_MODBUS_STATS */
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_BufferedTransportFlush(MiniModbusBufferedTransport_t *transport)
+{
+    if (transport == NULL) {
+        return;
+    }
+
+    transport->start = 0;
+    transport->end = 0;
 }
@@ -0,0 +1,744 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "include/minimodbus_bridge.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#define MAX_EVENTS 64
+#define MBAP_HEADER_SIZE 7
+#define ERROR_CODE_BITMASK 0x80
+#define FUNCTION_READ_COILS 0x01
+#define FUNCTION_READ_INPUT_REGISTER 0x04
+
+enum {
+    BridgeState_Idle = 0,
+    BridgeState_Sending,
+    BridgeState_Receiving,
+    BridgeState_Silence,
+    BridgeState_Closed,
+};
+
+/*
+ * The epoll data of each file descriptor is the kind of object in the high 32 bits, and its index in the low ones.
+ */
+enum {
+    BridgeEvent_Wakeup = 0,
+    BridgeEvent_Listen,
+    BridgeEvent_Client,
+    BridgeEvent_Line,
+    BridgeEvent_Timer,
+};
+
+static void MiniModbus_BridgeWatch(MiniModbusBridge_t *bridge, int op, int fd, int kind, size_t index,
+                                   uint32_t events)
+{
+    struct epoll_event event = {.events = events, .data.u64 = (uint64_t)kind << 32 | index};
+    epoll_ctl(bridge->epoll_fd, op, fd, &event);
+}
+
+static void MiniModbus_BridgeArm(MiniModbusBridgeLine_t *line, uint32_t timeout_us)
+{
+    // a zero it_value disarms the timer
+    if (timeout_us == 0) {
+        timeout_us = 1;
+    }
+
+    struct itimerspec spec = {.it_value = {.tv_sec = timeout_us / 1000000, .tv_nsec = timeout_us % 1000000 * 1000}};
+    timerfd_settime(line->timer_fd, 0, &spec, NULL);
+}
+
+static MiniModbusBridgeLine_t *MiniModbus_BridgeRoute(MiniModbusBridge_t *bridge, uint8_t unit)
+{
+    // unit 0 (broadcast) goes to the first line with first_unit 0
+    for (size_t i = 0; i < bridge->line_count; i++) {
+        if (unit >= bridge->lines[i]->first_unit && unit <= bridge->lines[i]->last_unit) {
+            return bridge->lines[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void MiniModbus_BridgeForget(MiniModbusBridgeRequest_t *request, const MiniModbusBridgeClient_t *client)
+{
+    for (; request != NULL; request = request->coalesced) {
+        if (request->client == client) {
+            request->client = NULL;
+        }
+    }
+}
+
+static void MiniModbus_BridgeClientClose(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client)
+{
+    epoll_ctl(bridge->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+
+    // requests already queued are still executed (a write can't be taken back), only their responses are dropped
+    for (size_t i = 0; i < bridge->line_count; i++) {
+        MiniModbusBridgeLine_t *line = bridge->lines[i];
+
+        MiniModbus_BridgeForget(line->current, client);
+        for (MiniModbusBridgeRequest_t *request = line->head; request != NULL; request = request->next) {
+            MiniModbus_BridgeForget(request, client);
+        }
+    }
+}
+
+static void MiniModbus_BridgeClientFlush(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client)
+{
+    size_t sent = 0;
+
+    while (sent < client->output_length) {
+        ssize_t result = send(client->fd, client->output + sent, client->output_length - sent, MSG_NOSIGNAL);
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            MiniModbus_BridgeWatch(bridge, EPOLL_CTL_MOD, client->fd, BridgeEvent_Client, client - bridge->clients,
+                                   EPOLLIN | EPOLLOUT);
+            break;
+        }
+        if (result < 0) {
+            MiniModbus_BridgeClientClose(bridge, client);
+            return;
+        }
+        sent += result;
+    }
+
+    memmove(client->output, client->output + sent, client->output_length - sent);
+    client->output_length -= sent;
+}
+
+static void MiniModbus_BridgeRespond(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client,
+                                     uint16_t transaction_id, uint8_t unit, const uint8_t *pdu, size_t pdu_length)
+{
+    size_t length = MBAP_HEADER_SIZE + pdu_length;
+
+    if (client->fd < 0) {
+        return;
+    }
+    if (client->output_length + length > sizeof(client->output)) {
+        MiniModbus_BridgeClientClose(bridge, client);
+        return;
+    }
+
+    uint8_t *frame = client->output + client->output_length;
+    frame[0] = transaction_id >> 8;
+    frame[1] = transaction_id & 0xff;
+    frame[2] = 0;
+    frame[3] = 0;
+    frame[4] = (pdu_length + 1) >> 8;
+    frame[5] = (pdu_length + 1) & 0xff;
+    frame[6] = unit;
+    memcpy(frame + MBAP_HEADER_SIZE, pdu, pdu_length);
+    client->output_length += length;
+
+    // with older output pending, EPOLLOUT is already watched and will send this as well
+    if (client->output_length == length) {
+        MiniModbus_BridgeClientFlush(bridge, client);
+    }
+}
+
+static void MiniModbus_BridgeException(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client,
+                                       uint16_t transaction_id, uint8_t unit, uint8_t function_code,
+                                       MiniModbusError_t error)
+{
+    uint8_t pdu[2] = {function_code | ERROR_CODE_BITMASK, (uint8_t)error};
+    MiniModbus_BridgeRespond(bridge, client, transaction_id, unit, pdu, sizeof(pdu));
+}
+
+static void MiniModbus_BridgeLineSilence(MiniModbusBridgeLine_t *line, uint32_t timeout_us)
+{
+    line->state = BridgeState_Silence;
+    line->received = 0;
+    MiniModbus_BridgeArm(line, timeout_us);
+}
+
+/*
+ * Answer the request in progress and all the ones coalesced with it, with the response PDU or, if pdu is NULL, with
+ * a gateway target device failed to respond exception.
+ */
+static void MiniModbus_BridgeLineComplete(MiniModbusBridgeLine_t *line, const uint8_t *pdu, size_t pdu_length)
+{
+    MiniModbusBridge_t *bridge = line->bridge;
+    MiniModbusBridgeRequest_t *request = line->current;
+    uint8_t unit = request->frame[0];
+    uint8_t exception[2] = {request->frame[1] | ERROR_CODE_BITMASK, MiniModbusError_GatewayTargetDeviceFailedToRespond};
+
+    if (pdu == NULL) {
+        pdu = exception;
+        pdu_length = sizeof(exception);
+    }
+
+    line->current = NULL;
+    while (request != NULL) {
+        MiniModbusBridgeRequest_t *next = request->coalesced;
+
+        // broadcasts get no response, as on the serial line
+        if (request->client != NULL && unit != 0) {
+            MiniModbus_BridgeRespond(bridge, request->client, request->transaction_id, unit, pdu, pdu_length);
+        }
+        request->next = bridge->free_requests;
+        bridge->free_requests = request;
+        request = next;
+    }
+
+    MiniModbus_BridgeLineSilence(line, line->silence_us);
+}
+
+static void MiniModbus_BridgeLineSend(MiniModbusBridgeLine_t *line)
+{
+    MiniModbusBridgeRequest_t *request = line->current;
+
+    while (line->sent < request->length) {
+        ssize_t sent = write(line->fd, request->frame + line->sent, request->length - line->sent);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (line->state != BridgeState_Sending) {
+                line->state = BridgeState_Sending;
+                MiniModbus_BridgeWatch(line->bridge, EPOLL_CTL_MOD, line->fd, BridgeEvent_Line, line->index,
+                                       EPOLLIN | EPOLLOUT);
+            }
+            return;
+        }
+        if (sent < 0) {
+            line->errors++;
+            MiniModbus_BridgeLineComplete(line, NULL, 0);
+            return;
+        }
+        line->sent += sent;
+    }
+
+    if (line->state == BridgeState_Sending) {
+        MiniModbus_BridgeWatch(line->bridge, EPOLL_CTL_MOD, line->fd, BridgeEvent_Line, line->index, EPOLLIN);
+    }
+
+    // write() returns when the frame is in the driver buffer, not on the wire: count its transmission time
+    uint32_t transmission_us = request->length * line->char_us;
+    if (request->frame[0] == 0) {
+        MiniModbus_BridgeLineComplete(line, NULL, 0);
+        MiniModbus_BridgeArm(line, transmission_us + line->turnaround_ms * 1000);
+        return;
+    }
+
+    line->state = BridgeState_Receiving;
+    line->received = 0;
+    MiniModbus_BridgeArm(line, transmission_us + line->timeout_ms * 1000);
+}
+
+static void MiniModbus_BridgeLineNext(MiniModbusBridgeLine_t *line)
+{
+    line->state = BridgeState_Idle;
+    if (line->head == NULL) {
+        return;
+    }
+
+    line->current = line->head;
+    line->head = line->head->next;
+    if (line->head == NULL) {
+        line->tail = NULL;
+    }
+    line->sent = 0;
+    MiniModbus_BridgeLineSend(line);
+}
+
+static void MiniModbus_BridgeLineClose(MiniModbusBridgeLine_t *line)
+{
+    MiniModbusBridge_t *bridge = line->bridge;
+
+    epoll_ctl(bridge->epoll_fd, EPOLL_CTL_DEL, line->fd, NULL);
+    epoll_ctl(bridge->epoll_fd, EPOLL_CTL_DEL, line->timer_fd, NULL);
+    line->errors++;
+
+    // fail the request in progress and all the queued ones
+    while (line->current != NULL || line->head != NULL) {
+        if (line->current == NULL) {
+            line->current = line->head;
+            line->head = line->head->next;
+        }
+        MiniModbus_BridgeLineComplete(line, NULL, 0);
+    }
+    line->tail = NULL;
+    line->state = BridgeState_Closed;
+}
+
+static void MiniModbus_BridgeLineReceive(MiniModbusBridgeLine_t *line)
+{
+    for (;;) {
+        ssize_t received = read(line->fd, line->buffer + line->received, sizeof(line->buffer) - line->received);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received <= 0) {
+            MiniModbus_BridgeLineClose(line);
+            return;
+        }
+
+        // noise or a late response: it's discarded, and the line is not silent till it ends
+        if (line->state != BridgeState_Receiving) {
+            if (line->state == BridgeState_Silence) {
+                MiniModbus_BridgeArm(line, line->silence_us);
+            }
+            continue;
+        }
+
+        line->received += received;
+        size_t length = MiniModbus_FrameLength(MiniModbusMode_RTU, 0, line->buffer, line->received);
+        if (length == 0 || length > sizeof(line->buffer)) {
+            line->errors++;
+            MiniModbus_BridgeLineComplete(line, NULL, 0);
+            continue;
+        }
+        if (line->received < length) {
+            continue;
+        }
+
+        const uint8_t *request = line->current->frame;
+        uint16_t crc = line->buffer[length - 2] | line->buffer[length - 1] << 8;
+        if (crc != MiniModbus_Crc16(line->buffer, length - 2) || line->buffer[0] != request[0] ||
+            (line->buffer[1] & ~ERROR_CODE_BITMASK) != request[1]) {
+            line->errors++;
+            MiniModbus_BridgeLineComplete(line, NULL, 0);
+            continue;
+        }
+        MiniModbus_BridgeLineComplete(line, line->buffer + 1, length - 3);
+    }
+}
+
+static void MiniModbus_BridgeLineTimer(MiniModbusBridgeLine_t *line)
+{
+    uint64_t expirations;
+
+    // the timer may have been armed again after this event was reported
+    if (read(line->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+
+    switch (line->state) {
+    case BridgeState_Receiving:
+        line->timeouts++;
+        MiniModbus_BridgeLineComplete(line, NULL, 0);
+        break;
+    case BridgeState_Silence:
+        MiniModbus_BridgeLineNext(line);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Find a request for the same read already on the line, to answer both with a single transaction. Only a read queued
+ * after the last write to the same unit (or broadcast) qualifies: an earlier one would miss the effect of the write.
+ */
+static MiniModbusBridgeRequest_t *MiniModbus_BridgeFindRead(MiniModbusBridgeLine_t *line, const uint8_t *frame,
+                                                            size_t length)
+{
+    MiniModbusBridgeRequest_t *found = NULL;
+    MiniModbusBridgeRequest_t *request = line->current != NULL ? line->current : line->head;
+
+    while (request != NULL) {
+        uint8_t function_code = request->frame[1];
+        if (request->length == length && memcmp(request->frame, frame, length) == 0) {
+            found = request;
+        } else if ((request->frame[0] == frame[0] || request->frame[0] == 0) &&
+                   (function_code < FUNCTION_READ_COILS || function_code > FUNCTION_READ_INPUT_REGISTER)) {
+            found = NULL;
+        }
+        request = request == line->current ? line->head : request->next;
+    }
+
+    return found;
+}
+
+/*
+ * Queue a request from a client. Returns -1 if the frame is not a Modbus TCP request and the connection must be
+ * closed, otherwise errors are reported to the client with an exception.
+ */
+static int MiniModbus_BridgeRequest(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client,
+                                    const uint8_t *frame, size_t length)
+{
+    uint16_t transaction_id = frame[0] << 8 | frame[1];
+    uint8_t unit = frame[6];
+    const uint8_t *pdu = frame + MBAP_HEADER_SIZE;
+    size_t pdu_length = length - MBAP_HEADER_SIZE;
+
+    if (frame[2] != 0 || frame[3] != 0) {
+        return -1;
+    }
+
+    MiniModbusBridgeLine_t *line = MiniModbus_BridgeRoute(bridge, unit);
+    if (line == NULL || line->state == BridgeState_Closed) {
+        MiniModbus_BridgeException(bridge, client, transaction_id, unit, pdu[0],
+                                   MiniModbusError_GatewayPathUnavailable);
+        return 0;
+    }
+
+    // only function codes the RTU framing can delimit are forwarded
+    uint8_t rtu[MINI_MODBUS_BRIDGE_RTU_FRAME_SIZE];
+    size_t rtu_length = 1 + pdu_length + 2;
+    rtu[0] = unit;
+    memcpy(rtu + 1, pdu, pdu_length);
+    size_t expected = MiniModbus_FrameLength(MiniModbusMode_RTU, 1, rtu, rtu_length);
+    if (expected != rtu_length) {
+        MiniModbus_BridgeException(bridge, client, transaction_id, unit, pdu[0],
+                                   expected == 0 ? MiniModbusError_IllegalFunction
+                                                 : MiniModbusError_IllegalDataValue);
+        return 0;
+    }
+    uint16_t crc = MiniModbus_Crc16(rtu, rtu_length - 2);
+    rtu[rtu_length - 2] = crc & 0xff;
+    rtu[rtu_length - 1] = crc >> 8;
+
+    MiniModbusBridgeRequest_t *request = bridge->free_requests;
+    if (request == NULL) {
+        MiniModbus_BridgeException(bridge, client, transaction_id, unit, pdu[0], MiniModbusError_ServerDeviceBusy);
+        return 0;
+    }
+    bridge->free_requests = request->next;
+    request->client = client;
+    request->transaction_id = transaction_id;
+    request->next = NULL;
+    request->coalesced = NULL;
+
+    // reads have no side effects: identical ones waiting on the line share the transaction
+    MiniModbusBridgeRequest_t *leader = NULL;
+    if (unit != 0 && pdu[0] >= FUNCTION_READ_COILS && pdu[0] <= FUNCTION_READ_INPUT_REGISTER) {
+        leader = MiniModbus_BridgeFindRead(line, rtu, rtu_length);
+    }
+    if (leader != NULL) {
+        request->coalesced = leader->coalesced;
+        leader->coalesced = request;
+        line->coalesced++;
+        return 0;
+    }
+
+    memcpy(request->frame, rtu, rtu_length);
+    request->length = rtu_length;
+    if (line->tail != NULL) {
+        line->tail->next = request;
+    } else {
+        line->head = request;
+    }
+    line->tail = request;
+    line->requests++;
+
+    if (line->state == BridgeState_Idle) {
+        MiniModbus_BridgeLineNext(line);
+    }
+
+    return 0;
+}
+
+static void MiniModbus_BridgeClientReceive(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *client)
+{
+    for (;;) {
+        ssize_t received = recv(client->fd, client->input + client->received,
+                                sizeof(client->input) - client->received, 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received <= 0) {
+            MiniModbus_BridgeClientClose(bridge, client);
+            return;
+        }
+        client->received += received;
+
+        // clients can pipeline requests: process all the complete ones
+        for (;;) {
+            size_t length = MiniModbus_FrameLength(MiniModbusMode_TCP, 1, client->input, client->received);
+            if (client->received >= 6 && (length < MBAP_HEADER_SIZE + 1 || length > sizeof(client->input))) {
+                MiniModbus_BridgeClientClose(bridge, client);
+                return;
+            }
+            if (client->received < length) {
+                break;
+            }
+            if (MiniModbus_BridgeRequest(bridge, client, client->input, length) < 0 || client->fd < 0) {
+                if (client->fd >= 0) {
+                    MiniModbus_BridgeClientClose(bridge, client);
+                }
+                return;
+            }
+            memmove(client->input, client->input + length, client->received - length);
+            client->received -= length;
+        }
+    }
+}
+
+static void MiniModbus_BridgeAccept(MiniModbusBridge_t *bridge)
+{
+    int fd = accept4(bridge->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < bridge->max_clients; i++) {
+        MiniModbusBridgeClient_t *client = &bridge->clients[i];
+        if (client->fd >= 0) {
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        client->fd = fd;
+        client->received = 0;
+        client->output_length = 0;
+        MiniModbus_BridgeWatch(bridge, EPOLL_CTL_ADD, fd, BridgeEvent_Client, i, EPOLLIN);
+        return;
+    }
+
+    // all the clients are in use
+    close(fd);
+}
+
+static void MiniModbus_BridgeHandleEvent(MiniModbusBridge_t *bridge, uint64_t data, uint32_t events)
+{
+    size_t index = data & 0xffffffff;
+
+    switch (data >> 32) {
+    case BridgeEvent_Wakeup: {
+        uint64_t value;
+        if (read(bridge->wakeup_fd, &value, sizeof(value)) < 0) {
+            // nothing to do, the flag is checked anyway
+        }
+        break;
+    }
+    case BridgeEvent_Listen:
+        MiniModbus_BridgeAccept(bridge);
+        break;
+    case BridgeEvent_Client: {
+        MiniModbusBridgeClient_t *client = &bridge->clients[index];
+
+        // the client may have been closed by an earlier event of the same batch
+        if (client->fd >= 0 && (events & EPOLLOUT) != 0) {
+            MiniModbus_BridgeClientFlush(bridge, client);
+            if (client->fd >= 0 && client->output_length == 0) {
+                MiniModbus_BridgeWatch(bridge, EPOLL_CTL_MOD, client->fd, BridgeEvent_Client, index, EPOLLIN);
+            }
+        }
+        if (client->fd >= 0 && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+            MiniModbus_BridgeClientReceive(bridge, client);
+        }
+        break;
+    }
+    case BridgeEvent_Line: {
+        MiniModbusBridgeLine_t *line = bridge->lines[index];
+
+        if (line->state == BridgeState_Sending && (events & EPOLLOUT) != 0) {
+            MiniModbus_BridgeLineSend(line);
+        }
+        if (line->state != BridgeState_Closed && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+            MiniModbus_BridgeLineReceive(line);
+        }
+        break;
+    }
+    case BridgeEvent_Timer:
+        if (bridge->lines[index]->state != BridgeState_Closed) {
+            MiniModbus_BridgeLineTimer(bridge->lines[index]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void *MiniModbus_BridgeRun(void *arg)
+{
+    MiniModbusBridge_t *bridge = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (__atomic_load_n(&bridge->running, __ATOMIC_ACQUIRE)) {
+        int count = epoll_wait(bridge->epoll_fd, events, MAX_EVENTS, -1);
+
+        for (int i = 0; i < count; i++) {
+            MiniModbus_BridgeHandleEvent(bridge, events[i].data.u64, events[i].events);
+        }
+    }
+
+    for (size_t i = 0; i < bridge->max_clients; i++) {
+        if (bridge->clients[i].fd >= 0) {
+            close(bridge->clients[i].fd);
+            bridge->clients[i].fd = -1;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Release what MiniModbus_BridgeStart() created. The thread must not be running.
+ */
+static void MiniModbus_BridgeRelease(MiniModbusBridge_t *bridge)
+{
+    for (size_t i = 0; i < bridge->line_count; i++) {
+        if (bridge->lines[i]->timer_fd >= 0) {
+            close(bridge->lines[i]->timer_fd);
+            bridge->lines[i]->timer_fd = -1;
+        }
+    }
+    if (bridge->epoll_fd >= 0) {
+        close(bridge->epoll_fd);
+        bridge->epoll_fd = -1;
+    }
+    if (bridge->wakeup_fd >= 0) {
+        close(bridge->wakeup_fd);
+        bridge->wakeup_fd = -1;
+    }
+}
+
+MiniModbusError_t MiniModbus_BridgeInit(MiniModbusBridge_t *bridge, MiniModbusBridgeClient_t *clients,
+                                        size_t max_clients, MiniModbusBridgeRequest_t *requests, size_t max_requests)
+{
+    if (bridge == NULL || clients == NULL || max_clients == 0 || requests == NULL || max_requests == 0) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(bridge, 0, sizeof(MiniModbusBridge_t));
+    bridge->clients = clients;
+    bridge->max_clients = max_clients;
+    bridge->requests = requests;
+    bridge->max_requests = max_requests;
+    bridge->listen_fd = -1;
+    bridge->epoll_fd = -1;
+    bridge->wakeup_fd = -1;
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_BridgeLineInit(MiniModbusBridgeLine_t *line, int fd, uint32_t baud_rate, uint8_t first_unit,
+                               uint8_t last_unit)
+{
+    if (line == NULL) {
+        return;
+    }
+
+    memset(line, 0, sizeof(MiniModbusBridgeLine_t));
+    line->fd = fd;
+    line->baud_rate = baud_rate;
+    line->first_unit = first_unit;
+    line->last_unit = last_unit;
+    line->timeout_ms = 1000;
+    line->turnaround_ms = 100;
+    line->timer_fd = -1;
+}
+
+MiniModbusError_t MiniModbus_BridgeAddLine(MiniModbusBridge_t *bridge, MiniModbusBridgeLine_t *line)
+{
+    if (bridge == NULL || line == NULL || line->fd < 0 || line->baud_rate == 0 ||
+        line->first_unit > line->last_unit || bridge->line_count == MINI_MODBUS_BRIDGE_MAX_LINES ||
+        bridge->running) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    line->bridge = bridge;
+    line->index = bridge->line_count;
+    bridge->lines[bridge->line_count++] = line;
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_BridgeStart(MiniModbusBridge_t *bridge, int listen_fd)
+{
+    if (bridge == NULL || listen_fd < 0 || bridge->line_count == 0 || bridge->running) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    bridge->listen_fd = listen_fd;
+    bridge->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    bridge->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (bridge->epoll_fd < 0 || bridge->wakeup_fd < 0) {
+        MiniModbus_BridgeRelease(bridge);
+        return MiniModbusError_Generic;
+    }
+    MiniModbus_BridgeWatch(bridge, EPOLL_CTL_ADD, bridge->wakeup_fd, BridgeEvent_Wakeup, 0, EPOLLIN);
+    MiniModbus_BridgeWatch(bridge, EPOLL_CTL_ADD, listen_fd, BridgeEvent_Listen, 0, EPOLLIN);
+
+    for (size_t i = 0; i < bridge->max_clients; i++) {
+        bridge->clients[i].fd = -1;
+    }
+    bridge->free_requests = NULL;
+    for (size_t i = 0; i < bridge->max_requests; i++) {
+        bridge->requests[i].next = bridge->free_requests;
+        bridge->free_requests = &bridge->requests[i];
+    }
+
+    for (size_t i = 0; i < bridge->line_count; i++) {
+        MiniModbusBridgeLine_t *line = bridge->lines[i];
+
+        line->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (line->timer_fd < 0 || fcntl(line->fd, F_SETFL, fcntl(line->fd, F_GETFL) | O_NONBLOCK) < 0) {
+            MiniModbus_BridgeRelease(bridge);
+            return MiniModbusError_Generic;
+        }
+        MiniModbus_BridgeWatch(bridge, EPOLL_CTL_ADD, line->fd, BridgeEvent_Line, i, EPOLLIN);
+        MiniModbus_BridgeWatch(bridge, EPOLL_CTL_ADD, line->timer_fd, BridgeEvent_Timer, i, EPOLLIN);
+
+        // a character is 11 bits (start, 8 data, parity or second stop, stop). Frames are separated by 3.5
+        // characters of silence, fixed to 1750 us above 19200 bps
+        line->char_us = (11 * 1000000 + line->baud_rate - 1) / line->baud_rate;
+        line->silence_us = line->baud_rate > 19200 ? 1750 : (35 * line->char_us + 9) / 10;
+        line->state = BridgeState_Idle;
+        line->head = NULL;
+        line->tail = NULL;
+        line->current = NULL;
+    }
+
+    bridge->running = 1;
+    if (pthread_create(&bridge->thread, NULL, MiniModbus_BridgeRun, bridge) != 0) {
+        bridge->running = 0;
+        MiniModbus_BridgeRelease(bridge);
+        return MiniModbusError_Generic;
+    }
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_BridgeStop(MiniModbusBridge_t *bridge)
+{
+    uint64_t value = 1;
+
+    if (bridge == NULL || !bridge->running) {
+        return;
+    }
+
+    __atomic_store_n(&bridge->running, 0, __ATOMIC_RELEASE);
+    if (write(bridge->wakeup_fd, &value, sizeof(value)) < 0) {
+        // can't happen with an eventfd that is far from overflowing
+    }
+    pthread_join(bridge->thread, NULL);
+    MiniModbus_BridgeRelease(bridge);
+}
@@ -0,0 +1,212 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "include/minimodbus_bus.h"
+
+#include <string.h>
+
+// 1 start bit, 8 data bits, parity or second stop bit, stop bit
+#define RTU_BITS_PER_CHARACTER 11
+
+// above 19200 baud the standard fixes the inter-frame gap, instead of scaling it with the baud rate
+#define RTU_FIXED_GAP_BAUD_RATE 19200
+#define RTU_FIXED_GAP_US 1750
+
+#define DEFAULT_BROADCAST_DELAY_US 100000
+
+/*
+ * Wait till the line has been silent for the required time, then send.
+ */
+static int MiniModbus_BusSend(void *user_data, const void *data, size_t length)
+{
+    MiniModbusBus_t *bus = user_data;
+    void *transport_data = bus->transport.user_data;
+
+    uint32_t elapsed = bus->clock(transport_data) - bus->idle_since_us;
+    if (elapsed < bus->silence_us) {
+        bus->delay(transport_data, bus->silence_us - elapsed);
+    }
+
+    int sent = bus->transport.send(transport_data, data, length);
+
+    // a broadcast gets no response: the silence after it starts now
+    bus->idle_since_us = bus->clock(transport_data);
+    bus->silence_us = bus->ctx.config.slave_address == 0 ? bus->broadcast_delay_us : bus->frame_gap_us;
+
+    return sent;
+}
+
+static int MiniModbus_BusReceive(void *user_data, void *data, size_t length)
+{
+    MiniModbusBus_t *bus = user_data;
+
+    int received = bus->transport.receive(bus->transport.user_data, data, length);
+
+    bus->idle_since_us = bus->clock(bus->transport.user_data);
+    bus->silence_us = bus->frame_gap_us;
+
+    return received;
+}
+
+static int MiniModbus_BusReceiveTimeout(void *user_data, void *data, size_t length, uint32_t timeout_us)
+{
+    MiniModbusBus_t *bus = user_data;
+
+    int received = bus->transport.receive_timeout(bus->transport.user_data, data, length, timeout_us);
+
+    bus->idle_since_us = bus->clock(bus->transport.user_data);
+    bus->silence_us = bus->frame_gap_us;
+
+    return received;
+}
+
+static void MiniModbus_BusFlush(void *user_data)
+{
+    MiniModbusBus_t *bus = user_data;
+
+    bus->transport.flush(bus->transport.user_data);
+}
+
+static uint32_t MiniModbus_BusClock(void *user_data)
+{
+    MiniModbusBus_t *bus = user_data;
+
+    return bus->clock(bus->transport.user_data);
+}
+
+MiniModbusError_t MiniModbus_BusInit(MiniModbusBus_t *bus, const MiniModbusConfig_t *config, uint32_t baud_rate,
+                                     uint32_t (*clock)(void *user_data), void (*delay)(void *user_data, uint32_t us))
+{
+    if (bus == NULL || config == NULL || config->mode != MiniModbusMode_RTU || config->send == NULL ||
+        config->receive == NULL || baud_rate == 0 || clock == NULL || delay == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(bus, 0, sizeof(MiniModbusBus_t));
+    memcpy(&bus->transport, config, sizeof(MiniModbusConfig_t));
+    bus->clock = clock;
+    bus->delay = delay;
+    bus->broadcast_delay_us = DEFAULT_BROADCAST_DELAY_US;
+
+    // 3.5 characters, rounded up
+    bus->frame_gap_us = baud_rate > RTU_FIXED_GAP_BAUD_RATE
+                            ? RTU_FIXED_GAP_US
+                            : (uint32_t)((7ULL * RTU_BITS_PER_CHARACTER * 1000000 + 2ULL * baud_rate - 1) /
+                                         (2ULL * baud_rate));
+    bus->silence_us = bus->frame_gap_us;
+    bus->idle_since_us = clock(config->user_data);
+
+    MiniModbusConfig_t bus_config = {
+        .mode = MiniModbusMode_RTU,
+        .user_data = bus,
+        .receive = MiniModbus_BusReceive,
+        .send = MiniModbus_BusSend,
+        .receive_timeout = config->receive_timeout != NULL ? MiniModbus_BusReceiveTimeout : NULL,
+        .flush = config->flush != NULL ? MiniModbus_BusFlush : NULL,
+        .clock = MiniModbus_BusClock,
+        .timeout_us = config->timeout_us,
+        .timeout_min_us = config->timeout_min_us,
+        .retries = config->retries,
+    };
+
+    return MiniModbus_Init(&bus->ctx, &bus_config);
+}
+
+MiniModbusError_t MiniModbus_BusAddJob(MiniModbusBus_t *bus, MiniModbusBusJob_t *job)
+{
+    if (bus == NULL || job == NULL || job->execute == NULL || job->priority >= MINI_MODBUS_BUS_PRIORITIES) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    job->next_time_us = bus->clock(bus->transport.user_data);
+    job->result = MiniModbusError_Success;
+    job->next = bus->jobs;
+    bus->jobs = job;
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_BusRemoveJob(MiniModbusBus_t *bus, MiniModbusBusJob_t *job)
+{
+    if (bus == NULL || job == NULL) {
+        return;
+    }
+
+    for (MiniModbusBusJob_t **link = &bus->jobs; *link != NULL; link = &(*link)->next) {
+        if (*link == job) {
+            *link = job->next;
+            job->next = NULL;
+            return;
+        }
+    }
+}
+
+MiniModbusError_t MiniModbus_BusStep(MiniModbusBus_t *bus, uint32_t *wait_us)
+{
+    if (bus == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    uint32_t now = bus->clock(bus->transport.user_data);
+    MiniModbusBusJob_t *best = NULL;
+    int32_t best_lateness = 0;
+    int32_t next_due = INT32_MAX;
+
+    // times wrap around: compare them by their signed difference
+    for (MiniModbusBusJob_t *job = bus->jobs; job != NULL; job = job->next) {
+        int32_t lateness = (int32_t)(now - job->next_time_us);
+        if (lateness < 0) {
+            if (-lateness < next_due) {
+                next_due = -lateness;
+            }
+        } else if (best == NULL || job->priority < best->priority ||
+                   (job->priority == best->priority && lateness > best_lateness)) {
+            best = job;
+            best_lateness = lateness;
+        }
+    }
+
+    if (best == NULL) {
+        if (wait_us != NULL) {
+            *wait_us = (uint32_t)next_due;
+        }
+        return MiniModbusError_Pending;
+    }
+
+    if (best->period_us == 0) {
+        MiniModbus_BusRemoveJob(bus, best);
+    } else {
+        // no executions are queued when the bus is overloaded: a late job just runs as soon as possible
+        best->next_time_us += best->period_us;
+        if ((int32_t)(now - best->next_time_us) > 0) {
+            best->next_time_us = now;
+        }
+    }
+
+    MiniModbus_SetSlaveAddress(&bus->ctx, best->slave_address);
+    best->result = best->execute(&bus->ctx, best);
+
+    return best->result;
+}
@@ -0,0 +1,234 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "include/minimodbus_capture.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FUNCTION_READ_HOLDING_REGISTERS 0x03
+#define FUNCTION_READ_INPUT_REGISTERS 0x04
+
+/*
+ * Records are read by other processes while they are written: each record is a seqlock. The producer clears the
+ * sequence of the slot, writes the fields, and then publishes the new sequence with release semantics; a consumer
+ * reads the sequence with acquire semantics, the fields, and then the sequence again. The fields can only be trusted
+ * if both reads found the expected sequence.
+ */
+
+static uint64_t MiniModbus_CaptureNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static size_t MiniModbus_CaptureSize(uint32_t capacity)
+{
+    return sizeof(MiniModbusCaptureHeader_t) + (size_t)capacity * sizeof(MiniModbusCaptureRecord_t);
+}
+
+static void MiniModbus_CaptureMap(MiniModbusCapture_t *capture, void *map, size_t size)
+{
+    capture->header = map;
+    capture->records = (MiniModbusCaptureRecord_t *)((uint8_t *)map + sizeof(MiniModbusCaptureHeader_t));
+    capture->size = size;
+    capture->head = capture->header->head;
+}
+
+MiniModbusError_t MiniModbus_CaptureCreate(MiniModbusCapture_t *capture, const char *path, uint32_t capacity)
+{
+    if (capture == NULL || path == NULL || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // a new file, not a truncated one: consumers that still map the old capture would get SIGBUS
+    unlink(path);
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return MiniModbusError_Generic;
+    }
+
+    // the file is sparse: pages are allocated as the ring fills
+    size_t size = MiniModbus_CaptureSize(capacity);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return MiniModbusError_Generic;
+    }
+
+    MiniModbusCaptureHeader_t *header = map;
+    header->version = MINI_MODBUS_CAPTURE_VERSION;
+    header->record_size = sizeof(MiniModbusCaptureRecord_t);
+    header->capacity = capacity;
+    header->head = 0;
+
+    // the magic is written last: a consumer that opens the file while it's created doesn't accept a partial header
+    __atomic_store_n(&header->magic, MINI_MODBUS_CAPTURE_MAGIC, __ATOMIC_RELEASE);
+    MiniModbus_CaptureMap(capture, map, size);
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_CaptureOpen(MiniModbusCapture_t *capture, const char *path)
+{
+    if (capture == NULL || path == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return MiniModbusError_Generic;
+    }
+
+    MiniModbusError_t error = MiniModbusError_InvalidArgument;
+    MiniModbusCaptureHeader_t header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) && fstat(fd, &st) == 0 &&
+        header.magic == MINI_MODBUS_CAPTURE_MAGIC && header.version == MINI_MODBUS_CAPTURE_VERSION &&
+        header.record_size == sizeof(MiniModbusCaptureRecord_t) && header.capacity != 0 &&
+        (header.capacity & (header.capacity - 1)) == 0 &&
+        (uint64_t)st.st_size >= MiniModbus_CaptureSize(header.capacity)) {
+        size_t size = MiniModbus_CaptureSize(header.capacity);
+        void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            MiniModbus_CaptureMap(capture, map, size);
+            error = MiniModbusError_Success;
+        } else {
+            error = MiniModbusError_Generic;
+        }
+    }
+    close(fd);
+
+    return error;
+}
+
+void MiniModbus_CaptureClose(MiniModbusCapture_t *capture)
+{
+    if (capture != NULL && capture->header != NULL) {
+        munmap(capture->header, capture->size);
+        capture->header = NULL;
+        capture->records = NULL;
+    }
+}
+
+void MiniModbus_CaptureAppend(MiniModbusCapture_t *capture, uint16_t device, uint8_t function_code, uint16_t address,
+                              uint16_t count, const uint16_t *values, MiniModbusError_t error)
+{
+    uint64_t timestamp_us = MiniModbus_CaptureNow();
+    uint64_t mask = capture->header->capacity - 1;
+    uint16_t offset = 0;
+
+    // a failed read still takes a record, so that consumers see the error
+    do {
+        uint16_t length = count - offset;
+        if (length > MINI_MODBUS_CAPTURE_WORDS) {
+            length = MINI_MODBUS_CAPTURE_WORDS;
+        }
+
+        MiniModbusCaptureRecord_t *record = &capture->records[capture->head & mask];
+        __atomic_store_n(&record->sequence, 0, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        record->timestamp_us = timestamp_us;
+        record->device = device;
+        record->function_code = function_code;
+        record->error = (int8_t)error;
+        record->address = address + offset;
+        record->count = length;
+        if (error == MiniModbusError_Success && values != NULL) {
+            memcpy(record->values, values + offset, length * sizeof(uint16_t));
+        }
+
+        capture->head++;
+        __atomic_store_n(&record->sequence, capture->head, __ATOMIC_RELEASE);
+        __atomic_store_n(&capture->header->head, capture->head, __ATOMIC_RELEASE);
+
+        offset += length;
+    } while (offset < count);
+}
+
+MiniModbusError_t MiniModbus_CaptureRead(MiniModbusCapture_t *capture, MiniModbusContext_t *ctx, uint16_t device,
+                                         uint8_t function_code, uint16_t reg, uint16_t quantity, uint16_t *values)
+{
+    MiniModbusError_t error;
+    switch (function_code) {
+    case FUNCTION_READ_HOLDING_REGISTERS:
+        error = MiniModbus_ReadHoldingRegisters(ctx, reg, quantity, values);
+        break;
+    case FUNCTION_READ_INPUT_REGISTERS:
+        error = MiniModbus_ReadInputRegisters(ctx, reg, quantity, values);
+        break;
+    default:
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // invalid arguments are a bug of the caller, not a result worth recording
+    if (capture != NULL && error != MiniModbusError_InvalidArgument) {
+        MiniModbus_CaptureAppend(capture, device, function_code, reg, quantity, values, error);
+    }
+
+    return error;
+}
+
+uint64_t MiniModbus_CaptureHead(const MiniModbusCapture_t *capture)
+{
+    return __atomic_load_n(&capture->header->head, __ATOMIC_ACQUIRE);
+}
+
+uint64_t MiniModbus_CaptureOldest(const MiniModbusCapture_t *capture, uint64_t head)
+{
+    uint32_t capacity = capture->header->capacity;
+
+    return head > capacity ? head - capacity : 0;
+}
+
+const MiniModbusCaptureRecord_t *MiniModbus_CaptureRecord(const MiniModbusCapture_t *capture, uint64_t sequence)
+{
+    const MiniModbusCaptureRecord_t *record = &capture->records[sequence & (capture->header->capacity - 1)];
+    if (__atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE) != sequence + 1) {
+        return NULL;
+    }
+
+    return record;
+}
+
+int MiniModbus_CaptureValid(const MiniModbusCaptureRecord_t *record, uint64_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&record->sequence, __ATOMIC_RELAXED) == sequence + 1;
+}
@@ -0,0 +1,544 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "include/minimodbus_gateway.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define FUNCTION_READ_HOLDING_REGISTER 0x03
+#define MAX_EVENTS 64
+
+enum {
+    GatewayState_Disconnected = 0,
+    GatewayState_Connecting,
+    GatewayState_Idle,
+    GatewayState_Sending,
+    GatewayState_Receiving,
+};
+
+static uint64_t MiniModbus_GatewayNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * The gateway only uses the non-blocking API of the context: the blocking transport is never called.
+ */
+static int MiniModbus_GatewayNoTransport(void *user_data, void *data, size_t length)
+{
+    (void)user_data;
+    (void)data;
+    (void)length;
+
+    return -1;
+}
+
+static int MiniModbus_GatewayNoSend(void *user_data, const void *data, size_t length)
+{
+    return MiniModbus_GatewayNoTransport(user_data, (void *)data, length);
+}
+
+static void MiniModbus_GatewayWatch(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                    uint32_t events)
+{
+    struct epoll_event event = {.events = events, .data.ptr = device};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, device->fd, &event);
+}
+
+static void MiniModbus_GatewayFinishCycle(MiniModbusGatewayDevice_t *device, uint64_t now)
+{
+    device->cycles++;
+    if (device->cycle_result != MiniModbusError_Success) {
+        device->failed_cycles++;
+    }
+
+    // schedule the next cycle one period after this one was due, but never in the past: no cycles are queued
+    device->next_time_ms += device->period_ms;
+    if (device->next_time_ms < now) {
+        device->next_time_ms = now;
+    }
+
+    if (device->on_poll != NULL) {
+        device->on_poll(device, device->cycle_result);
+    }
+}
+
+static void MiniModbus_GatewayDisconnect(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                         MiniModbusError_t error, uint64_t now)
+{
+    int in_cycle = device->state == GatewayState_Sending || device->state == GatewayState_Receiving;
+
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, device->fd, NULL);
+    close(device->fd);
+    device->fd = -1;
+    device->state = GatewayState_Disconnected;
+    MiniModbus_AsyncCancel(&device->ctx);
+
+    // the blocks not yet read in this cycle fail as well
+    if (in_cycle) {
+        for (size_t i = device->block; i < device->plan->block_count; i++) {
+            device->plan->blocks[i].result = error;
+        }
+        if (device->cycle_result == MiniModbusError_Success) {
+            device->cycle_result = error;
+        }
+        MiniModbus_GatewayFinishCycle(device, now);
+    }
+
+    device->next_time_ms = now + device->backoff_ms;
+    device->backoff_ms = device->backoff_ms * 2 > device->reconnect_max_ms ? device->reconnect_max_ms
+                                                                             : device->backoff_ms * 2;
+}
+
+static void MiniModbus_GatewaySend(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device, uint64_t now)
+{
+    while (device->frame_sent < device->frame_length) {
+        ssize_t sent = send(device->fd, device->frame + device->frame_sent, device->frame_length - device->frame_sent,
+                            MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (device->state != GatewayState_Sending) {
+                device->state = GatewayState_Sending;
+                MiniModbus_GatewayWatch(worker, device, EPOLLOUT);
+            }
+            return;
+        }
+        if (sent < 0) {
+            MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Send, now);
+            return;
+        }
+        device->frame_sent += sent;
+    }
+
+    if (device->state == GatewayState_Sending) {
+        MiniModbus_GatewayWatch(worker, device, EPOLLIN);
+    }
+    device->state = GatewayState_Receiving;
+}
+
+static void MiniModbus_GatewayStartBlock(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                         uint64_t now)
+{
+    MiniModbusPollPlan_t *plan = device->plan;
+
+    while (device->block < plan->block_count) {
+        MiniModbusPollBlock_t *block = &plan->blocks[device->block];
+        MiniModbusError_t error;
+
+        if (plan->function_code == FUNCTION_READ_HOLDING_REGISTER) {
+            error = MiniModbus_AsyncReadHoldingRegisters(&device->ctx, block->start, block->quantity, device->values,
+                                                         &device->frame, &device->frame_length);
+        } else {
+            error = MiniModbus_AsyncReadInputRegisters(&device->ctx, block->start, block->quantity, device->values,
+                                                       &device->frame, &device->frame_length);
+        }
+
+        if (error == MiniModbusError_Success) {
+            device->frame_sent = 0;
+            device->deadline_ms = now + device->timeout_ms;
+            MiniModbus_GatewaySend(worker, device, now);
+            return;
+        }
+
+        // the block doesn't fit this context: skip it
+        block->result = error;
+        if (device->cycle_result == MiniModbusError_Success) {
+            device->cycle_result = error;
+        }
+        device->block++;
+    }
+
+    device->state = GatewayState_Idle;
+    device->backoff_ms = device->reconnect_min_ms;
+    MiniModbus_GatewayFinishCycle(device, now);
+}
+
+static void MiniModbus_GatewayCompleteBlock(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                            MiniModbusError_t error, uint64_t now)
+{
+    MiniModbusPollPlan_t *plan = device->plan;
+    MiniModbusPollBlock_t *block = &plan->blocks[device->block];
+
+    if (error == MiniModbusError_Success) {
+        for (size_t i = block->first_point; i < block->first_point + block->point_count; i++) {
+            *plan->points[i].value = device->values[plan->points[i].address - block->start];
+        }
+    }
+
+    block->result = error;
+    if (error != MiniModbusError_Success && device->cycle_result == MiniModbusError_Success) {
+        device->cycle_result = error;
+    }
+
+    // an exception from the device leaves the connection usable, a malformed response doesn't
+    if (error < 0) {
+        MiniModbus_GatewayDisconnect(worker, device, error, now);
+        return;
+    }
+
+    device->block++;
+    MiniModbus_GatewayStartBlock(worker, device, now);
+}
+
+static void MiniModbus_GatewayReceive(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                      uint64_t now)
+{
+    uint8_t data[MINI_MODBUS_MAX_FRAME_SIZE];
+
+    for (;;) {
+        ssize_t received = recv(device->fd, data, sizeof(data), 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (received <= 0) {
+            MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Receive, now);
+            return;
+        }
+
+        // data while no request is in progress, or after the end of the response, can't be matched to anything
+        size_t consumed = 0;
+        MiniModbusError_t error = MiniModbusError_ResponseInvalid;
+        if (device->state == GatewayState_Receiving) {
+            error = MiniModbus_AsyncFeed(&device->ctx, data, received, &consumed);
+        }
+        if (error == MiniModbusError_Pending) {
+            continue;
+        }
+        if (consumed != (size_t)received) {
+            MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_ResponseInvalid, now);
+            return;
+        }
+
+        MiniModbus_GatewayCompleteBlock(worker, device, error, now);
+        if (device->state != GatewayState_Sending && device->state != GatewayState_Receiving) {
+            return;
+        }
+    }
+}
+
+static void MiniModbus_GatewayConnect(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                      uint64_t now)
+{
+    device->connects++;
+    device->fd = socket(device->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (device->fd < 0) {
+        device->next_time_ms = now + device->backoff_ms;
+        return;
+    }
+
+    int one = 1;
+    setsockopt(device->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = device};
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, device->fd, &event);
+
+    device->state = GatewayState_Connecting;
+    device->deadline_ms = now + device->timeout_ms;
+
+    if (connect(device->fd, (const struct sockaddr *)&device->address, device->address_length) < 0 &&
+        errno != EINPROGRESS) {
+        MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Send, now);
+    }
+}
+
+static void MiniModbus_GatewayConnected(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                        uint64_t now)
+{
+    int error = 0;
+    socklen_t length = sizeof(error);
+
+    if (getsockopt(device->fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Send, now);
+        return;
+    }
+
+    device->state = GatewayState_Idle;
+    MiniModbus_GatewayWatch(worker, device, EPOLLIN);
+    if (device->next_time_ms < now) {
+        device->next_time_ms = now;
+    }
+}
+
+static void MiniModbus_GatewayHandleEvent(MiniModbusGatewayWorker_t *worker, MiniModbusGatewayDevice_t *device,
+                                          uint32_t events, uint64_t now)
+{
+    switch (device->state) {
+    case GatewayState_Connecting:
+        MiniModbus_GatewayConnected(worker, device, now);
+        break;
+    case GatewayState_Sending:
+        if ((events & (EPOLLERR | EPOLLHUP)) != 0) {
+            MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Send, now);
+        } else {
+            MiniModbus_GatewaySend(worker, device, now);
+        }
+        break;
+    case GatewayState_Idle:
+    case GatewayState_Receiving:
+        MiniModbus_GatewayReceive(worker, device, now);
+        break;
+    default:
+        break;
+    }
+}
+
+/*
+ * Run the timers of all the devices of the worker, returning the time till the next one expires.
+ */
+static int MiniModbus_GatewayTimers(MiniModbusGatewayWorker_t *worker, uint64_t now)
+{
+    uint64_t next = now + 1000;
+
+    for (MiniModbusGatewayDevice_t *device = worker->devices; device != NULL; device = device->next) {
+        switch (device->state) {
+        case GatewayState_Disconnected:
+            if (now >= device->next_time_ms) {
+                MiniModbus_GatewayConnect(worker, device, now);
+            }
+            break;
+        case GatewayState_Idle:
+            if (now >= device->next_time_ms) {
+                device->block = 0;
+                device->cycle_result = MiniModbusError_Success;
+                MiniModbus_GatewayStartBlock(worker, device, now);
+            }
+            break;
+        default:
+            if (now >= device->deadline_ms) {
+                MiniModbus_GatewayDisconnect(worker, device, MiniModbusError_Receive, now);
+            }
+            break;
+        }
+
+        uint64_t expire = device->state == GatewayState_Disconnected || device->state == GatewayState_Idle
+                              ? device->next_time_ms
+                              : device->deadline_ms;
+        if (expire < next) {
+            next = expire;
+        }
+    }
+
+    return next > now ? (int)(next - now) : 0;
+}
+
+static void *MiniModbus_GatewayWorkerRun(void *arg)
+{
+    MiniModbusGatewayWorker_t *worker = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    if (worker->cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    int timeout = MiniModbus_GatewayTimers(worker, MiniModbus_GatewayNow());
+
+    while (__atomic_load_n(&worker->gateway->running, __ATOMIC_ACQUIRE)) {
+        int count = epoll_wait(worker->epoll_fd, events, MAX_EVENTS, timeout);
+        uint64_t now = MiniModbus_GatewayNow();
+
+        for (int i = 0; i < count; i++) {
+            MiniModbusGatewayDevice_t *device = events[i].data.ptr;
+            if (device == NULL) {
+                uint64_t value;
+                if (read(worker->wakeup_fd, &value, sizeof(value)) < 0) {
+                    // nothing to do, the flag is checked anyway
+                }
+                continue;
+            }
+            MiniModbus_GatewayHandleEvent(worker, device, events[i].events, now);
+        }
+
+        timeout = MiniModbus_GatewayTimers(worker, now);
+    }
+
+    for (MiniModbusGatewayDevice_t *device = worker->devices; device != NULL; device = device->next) {
+        if (device->fd >= 0) {
+            close(device->fd);
+            device->fd = -1;
+        }
+        device->state = GatewayState_Disconnected;
+    }
+
+    return NULL;
+}
+
+MiniModbusError_t MiniModbus_GatewayInit(MiniModbusGateway_t *gateway, MiniModbusGatewayWorker_t *workers,
+                                         size_t worker_count, int pin_cpus)
+{
+    if (gateway == NULL || workers == NULL || worker_count == 0) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(gateway, 0, sizeof(MiniModbusGateway_t));
+    memset(workers, 0, worker_count * sizeof(MiniModbusGatewayWorker_t));
+    gateway->workers = workers;
+    gateway->worker_count = worker_count;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (size_t i = 0; i < worker_count; i++) {
+        workers[i].gateway = gateway;
+        workers[i].epoll_fd = -1;
+        workers[i].wakeup_fd = -1;
+        workers[i].cpu = pin_cpus && cpus > 0 ? (int)(i % cpus) : -1;
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusContext_t *MiniModbus_GatewayDeviceInit(MiniModbusGatewayDevice_t *device, uint8_t slave_address)
+{
+    if (device == NULL) {
+        return NULL;
+    }
+
+    memset(device, 0, sizeof(MiniModbusGatewayDevice_t));
+    device->period_ms = 1000;
+    device->timeout_ms = 1000;
+    device->reconnect_min_ms = 100;
+    device->reconnect_max_ms = 30000;
+    device->fd = -1;
+
+    MiniModbusConfig_t config = {
+        .mode = MiniModbusMode_TCP,
+        .slave_address = slave_address,
+        .user_data = device,
+        .receive = MiniModbus_GatewayNoTransport,
+        .send = MiniModbus_GatewayNoSend,
+    };
+    MiniModbus_Init(&device->ctx, &config);
+
+    return &device->ctx;
+}
+
+MiniModbusError_t MiniModbus_GatewayAddDevice(MiniModbusGateway_t *gateway, MiniModbusGatewayDevice_t *device)
+{
+    if (gateway == NULL || device == NULL || device->plan == NULL || device->address_length == 0 ||
+        __atomic_load_n(&gateway->running, __ATOMIC_ACQUIRE)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // shard the devices round robin between the workers
+    MiniModbusGatewayWorker_t *worker = &gateway->workers[gateway->next_worker];
+    gateway->next_worker = (gateway->next_worker + 1) % gateway->worker_count;
+
+    device->backoff_ms = device->reconnect_min_ms;
+    device->next_time_ms = 0;
+    device->next = worker->devices;
+    worker->devices = device;
+    worker->device_count++;
+
+    return MiniModbusError_Success;
+}
+
+/*
+ * Close the file descriptors of a worker whose thread is not running.
+ */
+static void MiniModbus_GatewayWorkerClose(MiniModbusGatewayWorker_t *worker)
+{
+    if (worker->epoll_fd >= 0) {
+        close(worker->epoll_fd);
+        worker->epoll_fd = -1;
+    }
+    if (worker->wakeup_fd >= 0) {
+        close(worker->wakeup_fd);
+        worker->wakeup_fd = -1;
+    }
+}
+
+MiniModbusError_t MiniModbus_GatewayStart(MiniModbusGateway_t *gateway)
+{
+    if (gateway == NULL || __atomic_load_n(&gateway->running, __ATOMIC_ACQUIRE)) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    __atomic_store_n(&gateway->running, 1, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < gateway->worker_count; i++) {
+        MiniModbusGatewayWorker_t *worker = &gateway->workers[i];
+
+        worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (worker->epoll_fd >= 0) {
+            worker->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        }
+        if (worker->epoll_fd < 0 || worker->wakeup_fd < 0) {
+            MiniModbus_GatewayWorkerClose(worker);
+            MiniModbus_GatewayStop(gateway);
+            return MiniModbusError_Generic;
+        }
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+        epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wakeup_fd, &event);
+
+        if (pthread_create(&worker->thread, NULL, MiniModbus_GatewayWorkerRun, worker) != 0) {
+            MiniModbus_GatewayWorkerClose(worker);
+            MiniModbus_GatewayStop(gateway);
+            return MiniModbusError_Generic;
+        }
+        worker->started = 1;
+    }
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_GatewayStop(MiniModbusGateway_t *gateway)
+{
+    if (gateway == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&gateway->running, 0, __ATOMIC_RELEASE);
+
+    // only the workers whose thread was started: a failed start already closed the others
+    for (size_t i = 0; i < gateway->worker_count; i++) {
+        MiniModbusGatewayWorker_t *worker = &gateway->workers[i];
+        uint64_t value = 1;
+
+        if (!worker->started) {
+            continue;
+        }
+        if (write(worker->wakeup_fd, &value, sizeof(value)) < 0) {
+            // the worker will notice the flag at its next timer anyway
+        }
+        pthread_join(worker->thread, NULL);
+        MiniModbus_GatewayWorkerClose(worker);
+        worker->started = 0;
+    }
+}
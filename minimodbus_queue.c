@@ -0,0 +1,284 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "include/minimodbus_queue.h"
+
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define FUNCTION_READ_COILS 0x01
+#define FUNCTION_READ_DISCRETE_INPUTS 0x02
+#define FUNCTION_READ_HOLDING_REGISTER 0x03
+#define FUNCTION_READ_INPUT_REGISTER 0x04
+#define FUNCTION_WRITE_SINGLE_COIL 0x05
+#define FUNCTION_WRITE_SINGLE_REGISTER 0x06
+#define FUNCTION_WRITE_MULTIPLE_COILS 0x0F
+#define FUNCTION_WRITE_MULTIPLE_REGISTERS 0x10
+#define FUNCTION_READ_WRITE_MULTIPLE_REGISTERS 0x17
+
+enum {
+    QueueJobState_Queued = 0,
+    QueueJobState_Waited,
+    QueueJobState_Done,
+};
+
+/*
+ * The ring is a bounded queue where each slot has a sequence number (Vyukov): slot i is free for the producer that
+ * claims position p when its sequence is p, and holds the job of position p when it's p + 1. Producers claim a
+ * position with a compare and swap on the head, then fill the slot and publish it; the consumer takes the slots in
+ * order, and frees each one for the position a lap later. No thread ever waits for a lock held by another.
+ */
+
+static void MiniModbus_QueueFutexWait(uint32_t *address, uint32_t value)
+{
+    syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void MiniModbus_QueueFutexWake(uint32_t *address)
+{
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static MiniModbusQueueJob_t *MiniModbus_QueueTake(MiniModbusQueue_t *queue)
+{
+    MiniModbusQueueSlot_t *slot = &queue->slots[queue->tail & queue->mask];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != queue->tail + 1) {
+        return NULL;
+    }
+
+    MiniModbusQueueJob_t *job = slot->job;
+    __atomic_store_n(&slot->sequence, queue->tail + queue->mask + 1, __ATOMIC_RELEASE);
+    queue->tail++;
+
+    return job;
+}
+
+static int MiniModbus_QueueEmpty(MiniModbusQueue_t *queue)
+{
+    MiniModbusQueueSlot_t *slot = &queue->slots[queue->tail & queue->mask];
+
+    return __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != queue->tail + 1;
+}
+
+static MiniModbusError_t MiniModbus_QueueRun(MiniModbusContext_t *ctx, MiniModbusQueueJob_t *job)
+{
+    if (job->execute != NULL) {
+        return job->execute(ctx, job);
+    }
+
+    switch (job->function_code) {
+    case FUNCTION_READ_COILS:
+        return MiniModbus_ReadCoils(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_READ_DISCRETE_INPUTS:
+        return MiniModbus_ReadDiscreteInputs(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_READ_HOLDING_REGISTER:
+        return MiniModbus_ReadHoldingRegisters(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_READ_INPUT_REGISTER:
+        return MiniModbus_ReadInputRegisters(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_WRITE_SINGLE_COIL:
+        return job->values == NULL ? MiniModbusError_InvalidArgument
+                                   : MiniModbus_WriteSingleCoil(ctx, job->reg, *(const uint8_t *)job->values != 0);
+    case FUNCTION_WRITE_SINGLE_REGISTER:
+        return job->values == NULL ? MiniModbusError_InvalidArgument
+                                   : MiniModbus_WriteSingleRegister(ctx, job->reg, *(const uint16_t *)job->values);
+    case FUNCTION_WRITE_MULTIPLE_COILS:
+        return MiniModbus_WriteMultipleCoils(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_WRITE_MULTIPLE_REGISTERS:
+        return MiniModbus_WriteMultipleRegisters(ctx, job->reg, job->quantity, job->values);
+    case FUNCTION_READ_WRITE_MULTIPLE_REGISTERS:
+        return MiniModbus_ReadWriteMultipleRegisters(ctx, job->reg, job->quantity, job->values, job->write_reg,
+                                                     job->write_quantity, job->write_values);
+    default:
+        return MiniModbusError_InvalidArgument;
+    }
+}
+
+static void MiniModbus_QueueComplete(MiniModbusQueue_t *queue, MiniModbusQueueJob_t *job, MiniModbusError_t result)
+{
+    void (*callback)(MiniModbusQueueJob_t *) = job->callback;
+
+    job->result = result;
+    queue->completed++;
+
+    // the waiter may reuse the job as soon as it sees it done: it's not touched after this, but for the wake up
+    if (__atomic_exchange_n(&job->state, QueueJobState_Done, __ATOMIC_ACQ_REL) == QueueJobState_Waited) {
+        MiniModbus_QueueFutexWake(&job->state);
+    }
+    if (callback != NULL) {
+        callback(job);
+    }
+}
+
+static void *MiniModbus_QueueThread(void *arg)
+{
+    MiniModbusQueue_t *queue = arg;
+
+    for (;;) {
+        // drain the ring, running the transactions back to back
+        MiniModbusQueueJob_t *job = MiniModbus_QueueTake(queue);
+        if (job != NULL) {
+            MiniModbus_QueueComplete(queue, job, MiniModbus_QueueRun(queue->ctx, job));
+            continue;
+        }
+        if (!__atomic_load_n(&queue->running, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // announce the sleep before checking the ring again: a producer either sees the flag and wakes the thread
+        // up, or published its job before the check
+        __atomic_store_n(&queue->sleeping, 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (MiniModbus_QueueEmpty(queue) && __atomic_load_n(&queue->running, __ATOMIC_ACQUIRE)) {
+            queue->sleeps++;
+            MiniModbus_QueueFutexWait(&queue->sleeping, 1);
+        }
+        __atomic_store_n(&queue->sleeping, 0, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+static void MiniModbus_QueueWakeUp(MiniModbusQueue_t *queue)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST)) {
+        MiniModbus_QueueFutexWake(&queue->sleeping);
+    }
+}
+
+MiniModbusError_t MiniModbus_QueueInit(MiniModbusQueue_t *queue, MiniModbusContext_t *ctx,
+                                       MiniModbusQueueSlot_t *slots, size_t slot_count)
+{
+    if (queue == NULL || ctx == NULL || slots == NULL || slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    memset(queue, 0, sizeof(MiniModbusQueue_t));
+    queue->ctx = ctx;
+    queue->slots = slots;
+    queue->mask = slot_count - 1;
+    for (size_t i = 0; i < slot_count; i++) {
+        slots[i].sequence = i;
+        slots[i].job = NULL;
+    }
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_QueueStart(MiniModbusQueue_t *queue)
+{
+    if (queue == NULL || queue->running) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    queue->running = 1;
+    if (pthread_create(&queue->thread, NULL, MiniModbus_QueueThread, queue) != 0) {
+        queue->running = 0;
+        return MiniModbusError_Generic;
+    }
+
+    return MiniModbusError_Success;
+}
+
+void MiniModbus_QueueStop(MiniModbusQueue_t *queue)
+{
+    if (queue == NULL || !queue->running) {
+        return;
+    }
+
+    __atomic_store_n(&queue->running, 0, __ATOMIC_RELEASE);
+    MiniModbus_QueueWakeUp(queue);
+    pthread_join(queue->thread, NULL);
+}
+
+MiniModbusError_t MiniModbus_QueueSubmit(MiniModbusQueue_t *queue, MiniModbusQueueJob_t *job)
+{
+    if (queue == NULL || job == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    uint64_t position = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    MiniModbusQueueSlot_t *slot;
+    for (;;) {
+        slot = &queue->slots[position & queue->mask];
+        int64_t difference = (int64_t)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+
+        if (difference == 0) {
+            // on failure position is updated with the current head
+            if (__atomic_compare_exchange_n(&queue->head, &position, position + 1, 1, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // the slot still holds the job of the previous lap
+            return MiniModbusError_QueueFull;
+        } else {
+            position = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    job->result = MiniModbusError_Pending;
+    __atomic_store_n(&job->state, QueueJobState_Queued, __ATOMIC_RELAXED);
+    slot->job = job;
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+
+    MiniModbus_QueueWakeUp(queue);
+
+    return MiniModbusError_Success;
+}
+
+MiniModbusError_t MiniModbus_QueueWait(MiniModbusQueueJob_t *job)
+{
+    uint32_t state = QueueJobState_Queued;
+
+    if (job == NULL) {
+        return MiniModbusError_InvalidArgument;
+    }
+
+    // the I/O thread only makes a system call to wake up a job that is waited
+    __atomic_compare_exchange_n(&job->state, &state, QueueJobState_Waited, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE);
+    while (__atomic_load_n(&job->state, __ATOMIC_ACQUIRE) != QueueJobState_Done) {
+        MiniModbus_QueueFutexWait(&job->state, QueueJobState_Waited);
+    }
+
+    return job->result;
+}
+
+MiniModbusError_t MiniModbus_QueueExecute(MiniModbusQueue_t *queue, MiniModbusQueueJob_t *job)
+{
+    MiniModbusError_t error = MiniModbus_QueueSubmit(queue, job);
+    if (error != MiniModbusError_Success) {
+        return error;
+    }
+
+    return MiniModbus_QueueWait(job);
+}
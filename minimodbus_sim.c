@@ -0,0 +1,342 @@
+/*
+ * MiniModbus v1.0.0
+ * Minimal implementation of the Modbus protocol.
+ *
+ * Copyright (c) 2021-2022 Alessandro Righi <alessandro.righi@alerighi.it>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include "include/minimodbus_sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#define ERROR_CODE_BITMASK 0x80
+
+static uint32_t MiniModbusSim_Random(MiniModbusSim_t *sim)
+{
+    // xorshift32
+    uint32_t x = sim->random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->random_state = x;
+
+    return x;
+}
+
+static int MiniModbusSim_Happens(MiniModbusSim_t *sim, uint32_t rate_ppm)
+{
+    return rate_ppm > 0 && MiniModbusSim_Random(sim) % 1000000 < rate_ppm;
+}
+
+void MiniModbusSim_Init(MiniModbusSim_t *sim, MiniModbusMode_t mode, uint8_t slave_address, uint16_t *registers,
+                        size_t register_count)
+{
+    memset(sim, 0, sizeof(MiniModbusSim_t));
+    sim->mode = mode;
+    sim->slave_address = slave_address;
+    sim->random_state = 0x12345678;
+
+    MiniModbusConfig_t config = {
+        .mode = mode,
+        .slave_address = slave_address,
+    };
+    MiniModbus_ServerInit(&sim->server, &config);
+
+    // the same registers are served both as holding and input registers
+    sim->server.holding_registers.values = registers;
+    sim->server.holding_registers.count = register_count;
+    sim->server.input_registers = sim->server.holding_registers;
+}
+
+void MiniModbusSim_Config(MiniModbusSim_t *sim, MiniModbusConfig_t *config)
+{
+    memset(config, 0, sizeof(MiniModbusConfig_t));
+    config->mode = sim->mode;
+    config->slave_address = sim->slave_address;
+    config->user_data = sim;
+    config->send = MiniModbusSim_Send;
+    config->sendv = MiniModbusSim_Sendv;
+    config->receive = MiniModbusSim_Receive;
+    config->receive_timeout = MiniModbusSim_ReceiveTimeout;
+    config->flush = MiniModbusSim_Flush;
+}
+
+int MiniModbusSim_Send(void *user_data, const void *data, size_t length)
+{
+    MiniModbusSim_t *sim = user_data;
+    const uint8_t *frame = data;
+    size_t header_length = sim->mode == MiniModbusMode_TCP ? 7 : 1;
+
+    sim->send_calls++;
+    sim->response_length = 0;
+    sim->response_position = 0;
+
+    // a real slave just ignores frames that are corrupted or not addressed to it
+    if (length <= header_length + 2 || length > MINI_MODBUS_MAX_FRAME_SIZE ||
+        (sim->mode == MiniModbusMode_RTU && frame[0] != sim->slave_address && frame[0] != 0)) {
+        return (int)length;
+    }
+
+    sim->requests++;
+
+    if (sim->latency_us > 0) {
+        struct timespec delay = {sim->latency_us / 1000000, (sim->latency_us % 1000000) * 1000L};
+        nanosleep(&delay, NULL);
+    }
+
+    if (MiniModbusSim_Happens(sim, sim->drop_rate_ppm)) {
+        sim->injected_errors++;
+        return (int)length;
+    }
+
+    // a broadcast never gets a response, not even an exception
+    int broadcast = sim->mode == MiniModbusMode_RTU && frame[0] == 0;
+    if (!broadcast && MiniModbusSim_Happens(sim, sim->exception_rate_ppm)) {
+        sim->injected_errors++;
+        memcpy(sim->response, frame, header_length);
+        sim->response[header_length] = frame[header_length] | ERROR_CODE_BITMASK;
+        sim->response[header_length + 1] = MiniModbusError_ServerDeviceBusy;
+        sim->response_length = header_length + 2;
+        if (sim->mode == MiniModbusMode_TCP) {
+            sim->response[4] = 0;
+            sim->response[5] = 3;
+        } else {
+            uint16_t crc = MiniModbus_Crc16(sim->response, sim->response_length);
+            sim->response[sim->response_length++] = crc & 0xFF;
+            sim->response[sim->response_length++] = (crc >> 8) & 0xFF;
+        }
+    } else if (MiniModbus_ServerHandleFrame(&sim->server, frame, length, sim->response, &sim->response_length) !=
+               MiniModbusError_Success) {
+        sim->response_length = 0;
+        return (int)length;
+    }
+
+    if (sim->response_length > 0 && MiniModbusSim_Happens(sim, sim->corrupt_rate_ppm)) {
+        sim->injected_errors++;
+        // RTU: flip a bit of the CRC, TCP: of the transaction identifier
+        sim->response[sim->mode == MiniModbusMode_TCP ? 1 : sim->response_length - 1] ^= 0x01;
+    }
+
+    return (int)length;
+}
+
+int MiniModbusSim_Sendv(void *user_data, const MiniModbusIoVec_t *iov, size_t iov_count)
+{
+    uint8_t frame[MINI_MODBUS_MAX_FRAME_SIZE];
+    size_t length = 0;
+
+    // the slave needs the whole frame: gather it, counting a single call as writev(2) would be
+    for (size_t i = 0; i < iov_count; i++) {
+        if (length + iov[i].length > sizeof(frame)) {
+            return -1;
+        }
+        memcpy(frame + length, iov[i].data, iov[i].length);
+        length += iov[i].length;
+    }
+
+    return MiniModbusSim_Send(user_data, frame, length);
+}
+
+int MiniModbusSim_Receive(void *user_data, void *data, size_t length)
+{
+    MiniModbusSim_t *sim = user_data;
+
+    sim->receive_calls++;
+
+    if (sim->response_position + length > sim->response_length) {
+        return -1;
+    }
+
+    memcpy(data, sim->response + sim->response_position, length);
+    sim->response_position += length;
+
+    return (int)length;
+}
+
+int MiniModbusSim_ReceiveTimeout(void *user_data, void *data, size_t length, uint32_t timeout_us)
+{
+    (void)timeout_us;
+
+    // nothing else will arrive: the timeout expires right away, once the bytes the slave has to send are over
+    int received = MiniModbusSim_Read(user_data, data, length);
+
+    return received < 0 ? 0 : received;
+}
+
+void MiniModbusSim_Flush(void *user_data)
+{
+    MiniModbusSim_t *sim = user_data;
+
+    sim->response_position = sim->response_length;
+}
+
+int MiniModbusSim_Read(void *user_data, void *data, size_t length)
+{
+    MiniModbusSim_t *sim = user_data;
+
+    sim->receive_calls++;
+
+    if (sim->response_position == sim->response_length) {
+        return -1;
+    }
+
+    if (length > sim->response_length - sim->response_position) {
+        length = sim->response_length - sim->response_position;
+    }
+
+    memcpy(data, sim->response + sim->response_position, length);
+    sim->response_position += length;
+
+    return (int)length;
+}
+
+int MiniModbusSim_TcpListen(uint16_t port, uint16_t *bound_port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_length = sizeof(addr);
+
+    if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_length) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (bound_port != NULL) {
+        *bound_port = ntohs(addr.sin_port);
+    }
+
+    return fd;
+}
+
+typedef struct MiniModbusSimClient {
+    size_t received;
+    uint8_t request[MINI_MODBUS_MAX_FRAME_SIZE];
+} MiniModbusSimClient_t;
+
+static int MiniModbusSim_TcpClientRead(MiniModbusServer_t *server, int fd, MiniModbusSimClient_t *client)
+{
+    uint8_t response[MINI_MODBUS_MAX_FRAME_SIZE];
+    size_t response_length;
+    ssize_t n;
+
+    n = read(fd, client->request + client->received, sizeof(client->request) - client->received);
+    if (n <= 0) {
+        return -1;
+    }
+    client->received += n;
+
+    // serve all the complete requests received, a client may pipeline them
+    for (;;) {
+        if (client->received < 6) {
+            return 0;
+        }
+        size_t length = 6 + (((size_t)client->request[4] << 8) | client->request[5]);
+        if (length > MINI_MODBUS_MAX_FRAME_SIZE) {
+            return -1;
+        }
+        if (client->received < length) {
+            return 0;
+        }
+
+        if (MiniModbus_ServerHandleFrame(server, client->request, length, response, &response_length) ==
+                MiniModbusError_Success &&
+            response_length > 0 && write(fd, response, response_length) != (ssize_t)response_length) {
+            return -1;
+        }
+
+        memmove(client->request, client->request + length, client->received - length);
+        client->received -= length;
+    }
+}
+
+int MiniModbusSim_TcpServe(MiniModbusServer_t *server, int listen_fd, size_t max_clients, const volatile int *running)
+{
+    struct pollfd *fds = calloc(max_clients + 1, sizeof(struct pollfd));
+    MiniModbusSimClient_t *clients = calloc(max_clients + 1, sizeof(MiniModbusSimClient_t));
+    size_t count = 1;
+
+    if (fds == NULL || clients == NULL) {
+        free(fds);
+        free(clients);
+        return -1;
+    }
+
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+
+    while (*running) {
+        if (poll(fds, count, 100) < 0) {
+            break;
+        }
+
+        for (size_t i = count; i-- > 1;) {
+            if (fds[i].revents != 0 && MiniModbusSim_TcpClientRead(server, fds[i].fd, &clients[i]) < 0) {
+                // drop the connection, moving the last one in its place
+                close(fds[i].fd);
+                fds[i] = fds[count - 1];
+                clients[i] = clients[count - 1];
+                count--;
+            }
+        }
+
+        if ((fds[0].revents & POLLIN) != 0) {
+            int fd = accept(listen_fd, NULL, NULL);
+            if (fd >= 0 && count > max_clients) {
+                close(fd);
+            } else if (fd >= 0) {
+                fds[count].fd = fd;
+                fds[count].events = POLLIN;
+                fds[count].revents = 0;
+                clients[count].received = 0;
+                count++;
+            }
+        }
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        close(fds[i].fd);
+    }
+    free(fds);
+    free(clients);
+
+    return 0;
+}